@@ -0,0 +1,238 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+/*
+ * Allocator for the large kernel buffers of lab_2.1, lab_2.3 and lab_3.1.
+ *
+ * huge_alloc maps anonymous memory aligned to a 2 MB boundary (so also to 64 bytes
+ * for SIMD loads) and asks for transparent huge pages with MADV_HUGEPAGE. Nothing
+ * is touched here: pages land on the NUMA node of the thread that first writes
+ * them, so the caller should initialize the buffer with the same thread partition
+ * that later computes on it (huge_touch pre-faults one thread's part explicitly).
+ *
+ * kernel_alloc / kernel_free pick huge_alloc when KERNEL_ALLOC=huge is set in the
+ * environment and plain malloc otherwise, so the programs switch without rebuilding.
+ * With KERNEL_ALLOC set to anything (e.g. "malloc" for the baseline) the programs
+ * also print the placement and TLB statistics below.
+ *
+ * huge_report prints how much of a buffer is backed by huge pages and on which
+ * nodes its pages live; tlb_open / tlb_close count dTLB load misses of the calling
+ * thread through perf_event_open (where perf is not allowed they report -1).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define HUGE_PAGE (2u << 20)
+#define HUGE_HEADER 64
+#define HUGE_MAGIC 0x48554745u /* "HUGE" */
+#define HUGE_MAX_NODES 64
+#define HUGE_SAMPLES 1024
+
+typedef struct
+{
+    uint32_t magic;
+    void *base;
+    size_t len;
+} huge_header;
+
+/*
+ * huge_alloc: 2 MB aligned, huge-page advised anonymous memory of at least bytes.
+ * Returns NULL if the mapping fails. Release with huge_free.
+ */
+static inline void *huge_alloc(size_t bytes)
+{
+    size_t len = (bytes + HUGE_HEADER + 2 * (size_t)HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    void *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+    uintptr_t p = ((uintptr_t)base + HUGE_HEADER + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+#ifdef MADV_HUGEPAGE
+    madvise((void*)p, len - (p - (uintptr_t)base), MADV_HUGEPAGE);
+#endif
+    huge_header *h = (huge_header*)(p - HUGE_HEADER);
+    h->magic = HUGE_MAGIC;
+    h->base = base;
+    h->len = len;
+    return (void*)p;
+}
+
+static inline void huge_free(void *p)
+{
+    if (p == NULL)
+        return;
+    huge_header *h = (huge_header*)((uintptr_t)p - HUGE_HEADER);
+    if (h->magic == HUGE_MAGIC)
+        munmap(h->base, h->len);
+}
+
+/*
+ * huge_touch: write one zero per 4 KB page of bytes [lb, ub) of p, so the calling
+ * thread takes the first-touch fault for that part of the buffer.
+ */
+static inline void huge_touch(void *p, size_t lb, size_t ub)
+{
+    volatile unsigned char *c = (volatile unsigned char*)p;
+    for (size_t i = lb; i < ub; i += 4096)
+        c[i] = 0;
+}
+
+static inline int kernel_alloc_huge(void)
+{
+    static int mode = -1;
+    if (mode < 0)
+    {
+        const char *v = getenv("KERNEL_ALLOC");
+        mode = v != NULL && strcmp(v, "huge") == 0;
+    }
+    return mode;
+}
+
+static inline int kernel_alloc_stats(void)
+{
+    const char *v = getenv("KERNEL_ALLOC");
+    return v != NULL && *v != '\0';
+}
+
+static inline void *kernel_alloc(size_t bytes)
+{
+    return kernel_alloc_huge() ? huge_alloc(bytes) : malloc(bytes);
+}
+
+static inline void kernel_free(void *p)
+{
+    if (kernel_alloc_huge())
+        huge_free(p);
+    else
+        free(p);
+}
+
+/*
+ * huge_report: print the share of [p, p + bytes) inside AnonHugePages (from
+ * /proc/self/smaps) and the node of up to 1024 sampled pages (move_pages query).
+ */
+static inline void huge_report(const char *name, const void *p, size_t bytes)
+{
+    uintptr_t lo = (uintptr_t)p, hi = lo + bytes;
+    size_t huge_kb = 0;
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps != NULL)
+    {
+        char line[256];
+        int inside = 0;
+        while (fgets(line, sizeof(line), smaps) != NULL)
+        {
+            unsigned long start, end;
+            size_t kb;
+            if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+                inside = start < hi && end > lo;
+            else if (inside && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1)
+                huge_kb += kb;
+        }
+        fclose(smaps);
+    }
+
+    void *pages[HUGE_SAMPLES];
+    int status[HUGE_SAMPLES];
+    size_t count = bytes / 4096 < HUGE_SAMPLES ? bytes / 4096 + 1 : HUGE_SAMPLES;
+    for (size_t k = 0; k < count; k++)
+        pages[k] = (void*)((lo + bytes / count * k) & ~(uintptr_t)4095);
+    int nodes[HUGE_MAX_NODES] = {0}, unmapped = 0;
+    long rc = syscall(SYS_move_pages, 0, (unsigned long)count, pages, NULL, status, 0);
+    for (size_t k = 0; rc == 0 && k < count; k++)
+    {
+        if (status[k] >= 0 && status[k] < HUGE_MAX_NODES)
+            nodes[status[k]]++;
+        else
+            unmapped++;
+    }
+
+    /* the mapping is padded past the buffer, so its huge pages may exceed bytes */
+    double huge_share = bytes > 0 ? 100.0 * huge_kb * 1024.0 / bytes : 0.0;
+    printf("%s: %.1f MB at %p, huge pages %.0f%%", name, bytes / 1048576.0, p,
+           huge_share > 100.0 ? 100.0 : huge_share);
+    if (rc != 0)
+        printf(", nodes n/a\n");
+    else
+    {
+        printf(", nodes");
+        for (int i = 0; i < HUGE_MAX_NODES; i++)
+            if (nodes[i] > 0)
+                printf(" %d:%.0f%%", i, 100.0 * nodes[i] / count);
+        if (unmapped > 0)
+            printf(" untouched:%.0f%%", 100.0 * unmapped / count);
+        printf("\n");
+    }
+}
+
+/*
+ * tlb_open: start counting dTLB load misses of the calling thread. Returns the
+ * counter fd or -1. tlb_close sums and closes fds[0..count), -1 if any failed.
+ */
+static inline int tlb_open(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static inline long long tlb_close(const int *fds, int count)
+{
+    long long total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        long long v;
+        if (fds[i] < 0 || read(fds[i], &v, sizeof(v)) != (ssize_t)sizeof(v))
+            total = -1;
+        else if (total >= 0)
+            total += v;
+        if (fds[i] >= 0)
+            close(fds[i]);
+    }
+    return total;
+}
+
+#ifdef _OPENMP
+/*
+ * tlb_team_open: tlb_open on every thread of an OpenMP team of nthreads; libgomp
+ * reuses the same threads for later regions, so the counters follow the kernel.
+ * Close with tlb_team_close.
+ */
+static inline int *tlb_team_open(int nthreads)
+{
+    int *fds = (int*)malloc(sizeof(*fds) * nthreads);
+    if (fds == NULL)
+        return NULL;
+    for (int i = 0; i < nthreads; i++)
+        fds[i] = -1;
+    #pragma omp parallel num_threads(nthreads)
+    fds[omp_get_thread_num()] = tlb_open();
+    return fds;
+}
+#endif
+
+static inline long long tlb_team_close(int *fds, int nthreads)
+{
+    if (fds == NULL)
+        return -1;
+    long long total = tlb_close(fds, nthreads);
+    free(fds);
+    return total;
+}
+
+#endif
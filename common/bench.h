@@ -0,0 +1,205 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * Benchmark harness shared by the lab kernels: warm-up runs, repeated timed runs
+ * with median/min/mean/stddev, a STREAM-triad bandwidth peak to compare against,
+ * and CSV or JSON-lines output for tracking results between builds.
+ *
+ * BENCH_WARMUP and BENCH_REPS override the run counts, BENCH_OUT names the output
+ * file (".csv" gives CSV with a header, anything else one JSON object per line)
+ * and BENCH_TAG is copied into every record to tell builds apart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef struct
+{
+    int warmup;
+    int reps;
+    double median;
+    double min;
+    double mean;
+    double stddev;
+} bench_stats;
+
+typedef void (*bench_fn)(void *arg);
+
+static inline double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.e-9;
+}
+
+static inline int bench_env_int(const char *name, int def)
+{
+    const char *v = getenv(name);
+    return (v != NULL && *v != '\0') ? atoi(v) : def;
+}
+
+static inline int bench_cmp_double(const void *l, const void *r)
+{
+    double a = *(const double*)l, b = *(const double*)r;
+    return (a > b) - (a < b);
+}
+
+/*
+ * bench_run: call fn(arg) warmup times untimed, then reps times timed.
+ */
+static inline bench_stats bench_run(bench_fn fn, void *arg, int warmup, int reps)
+{
+    bench_stats st;
+    memset(&st, 0, sizeof(st));
+    warmup = bench_env_int("BENCH_WARMUP", warmup);
+    reps = bench_env_int("BENCH_REPS", reps);
+    if (warmup < 0)
+        warmup = 0;
+    if (reps < 1)
+        reps = 1;
+    st.warmup = warmup;
+    st.reps = reps;
+
+    for (int i = 0; i < warmup; i++)
+        fn(arg);
+
+    double *t = (double*)malloc(sizeof(*t) * reps);
+    if (t == NULL)
+        return st;
+    for (int i = 0; i < reps; i++)
+    {
+        double t0 = bench_now();
+        fn(arg);
+        t[i] = bench_now() - t0;
+    }
+
+    qsort(t, reps, sizeof(*t), bench_cmp_double);
+    st.min = t[0];
+    st.median = (reps % 2) ? t[reps / 2] : 0.5 * (t[reps / 2 - 1] + t[reps / 2]);
+    for (int i = 0; i < reps; i++)
+        st.mean += t[i];
+    st.mean /= reps;
+    for (int i = 0; i < reps; i++)
+        st.stddev += (t[i] - st.mean) * (t[i] - st.mean);
+    st.stddev = reps > 1 ? sqrt(st.stddev / (reps - 1)) : 0.0;
+    free(t);
+    return st;
+}
+
+/*
+ * bench_stream_peak: best-of-reps STREAM triad a = b + s * c bandwidth in GB/s,
+ * counting 3 * 8 bytes per element. count should be well past the last-level cache.
+ * The value is measured once, with the OpenMP thread count of the first call, and
+ * cached; call it before narrowing the thread count to get the machine peak.
+ */
+static inline double bench_stream_peak(size_t count)
+{
+    static double peak = 0.0;
+    if (peak > 0.0)
+        return peak;
+
+    double *a = (double*)malloc(sizeof(*a) * count);
+    double *b = (double*)malloc(sizeof(*b) * count);
+    double *c = (double*)malloc(sizeof(*c) * count);
+    if (a == NULL || b == NULL || c == NULL)
+    {
+        free(a);
+        free(b);
+        free(c);
+        return 0.0;
+    }
+    long long cnt = (long long)count;
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < cnt; i++)
+    {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+    for (int r = 0; r < 5; r++)
+    {
+        double t0 = bench_now();
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < cnt; i++)
+            a[i] = b[i] + 3.0 * c[i];
+        double t = bench_now() - t0;
+        double gbs = 3.0 * sizeof(double) * (double)count / t * 1.e-9;
+        if (gbs > peak)
+            peak = gbs;
+    }
+    free(a);
+    free(b);
+    free(c);
+    return peak;
+}
+
+static inline int bench_threads(void)
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/*
+ * bench_report: print one result line and append a record to BENCH_OUT.
+ * bytes and flops are the traffic and work of a single run; the roofline
+ * bound is min(peak_gflops, intensity * peak_gbs) with the compute roof
+ * omitted when peak_gflops is 0.
+ */
+static inline void bench_report(const char *kernel, int m, int n, int threads, bench_stats st,
+                                double bytes, double flops, double peak_gbs, double peak_gflops)
+{
+    double gbs = bytes / st.median * 1.e-9;
+    double gflops = flops / st.median * 1.e-9;
+    double intensity = bytes > 0.0 ? flops / bytes : 0.0;
+    double roof = intensity * peak_gbs;
+    if (peak_gflops > 0.0 && peak_gflops < roof)
+        roof = peak_gflops;
+
+    printf("%-14s median %.6f min %.6f stddev %.6f sec (%d reps)", kernel, st.median, st.min, st.stddev, st.reps);
+    if (bytes > 0.0)
+        printf(" | %.2f GB/s (%.0f%% of %.2f)", gbs, peak_gbs > 0.0 ? 100.0 * gbs / peak_gbs : 0.0, peak_gbs);
+    printf(" | %.3f GFLOP/s", gflops);
+    if (roof > 0.0)
+        printf(" (%.0f%% of roofline)", 100.0 * gflops / roof);
+    printf("\n");
+
+    const char *path = getenv("BENCH_OUT");
+    if (path == NULL || *path == '\0')
+        return;
+    const char *tag = getenv("BENCH_TAG");
+    if (tag == NULL)
+        tag = __DATE__ " " __TIME__;
+    size_t len = strlen(path);
+    int csv = len > 4 && strcmp(path + len - 4, ".csv") == 0;
+    FILE *out = fopen(path, "a");
+    if (out == NULL)
+        return;
+    if (csv)
+    {
+        fseek(out, 0, SEEK_END);
+        if (ftell(out) == 0)
+            fprintf(out, "tag,kernel,m,n,threads,warmup,reps,median,min,mean,stddev,gbs,gflops,peak_gbs\n");
+        fprintf(out, "\"%s\",%s,%d,%d,%d,%d,%d,%.9f,%.9f,%.9f,%.9f,%.4f,%.4f,%.4f\n",
+                tag, kernel, m, n, threads, st.warmup, st.reps, st.median, st.min, st.mean,
+                st.stddev, gbs, gflops, peak_gbs);
+    }
+    else
+        fprintf(out, "{\"tag\": \"%s\", \"kernel\": \"%s\", \"m\": %d, \"n\": %d, \"threads\": %d, "
+                "\"warmup\": %d, \"reps\": %d, \"median\": %.9f, \"min\": %.9f, \"mean\": %.9f, "
+                "\"stddev\": %.9f, \"gbs\": %.4f, \"gflops\": %.4f, \"peak_gbs\": %.4f}\n",
+                tag, kernel, m, n, threads, st.warmup, st.reps, st.median, st.min, st.mean,
+                st.stddev, gbs, gflops, peak_gbs);
+    fclose(out);
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef MATFILE_H
+#define MATFILE_H
+
+/*
+ * On-disk dense matrix for the out-of-core matvec modes of lab_2.1 and lab_3.1.
+ * The file is a MATFILE_HEADER-byte header followed by the row-major doubles, so
+ * row data starts on a page boundary and is used straight from the mapping.
+ *
+ * The streaming kernels walk the matrix in row panels: while a panel is being
+ * multiplied, the next ones are requested with MADV_WILLNEED (asynchronous
+ * readahead), and a finished panel is dropped with MADV_DONTNEED and
+ * POSIX_FADV_DONTNEED, so the resident set stays bounded even when the file is
+ * larger than RAM.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MATFILE_MAGIC 0x5654414dU /* "MATV" */
+#define MATFILE_VERSION 1
+#define MATFILE_HEADER 4096
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t m, n;
+} matfile_header;
+
+typedef struct
+{
+    int fd;
+    int64_t m, n;
+    size_t size;
+    unsigned char *map;
+    const double *a;
+} matfile;
+
+/*
+ * matfile_fill_fn: store rows lb <= i < ub of the matrix into rows[(i - lb) * n + j].
+ */
+typedef void (*matfile_fill_fn)(double *rows, int64_t lb, int64_t ub, int64_t n, void *arg);
+
+/*
+ * matfile_write: write an m x n matrix produced by fill, panel_rows rows at a time.
+ * Returns 0 on success, -1 on an allocation or I/O error.
+ */
+static inline int matfile_write(const char *path, int64_t m, int64_t n, int64_t panel_rows,
+                                matfile_fill_fn fill, void *arg)
+{
+    unsigned char header[MATFILE_HEADER];
+    matfile_header h = {MATFILE_MAGIC, MATFILE_VERSION, m, n};
+    if (panel_rows < 1)
+        panel_rows = 1;
+    double *rows = (double*)malloc(sizeof(*rows) * panel_rows * n + 1);
+    FILE *out = fopen(path, "wb");
+    if (rows == NULL || out == NULL)
+    {
+        free(rows);
+        if (out != NULL)
+            fclose(out);
+        return -1;
+    }
+    memset(header, 0, sizeof(header));
+    memcpy(header, &h, sizeof(h));
+    int err = fwrite(header, sizeof(header), 1, out) != 1;
+    for (int64_t lb = 0; lb < m && !err; lb += panel_rows)
+    {
+        int64_t ub = (lb + panel_rows < m) ? lb + panel_rows : m;
+        fill(rows, lb, ub, n, arg);
+        err = fwrite(rows, sizeof(*rows) * n, (size_t)(ub - lb), out) != (size_t)(ub - lb);
+    }
+    err |= fclose(out) != 0;
+    free(rows);
+    return err ? -1 : 0;
+}
+
+/*
+ * matfile_open: map the matrix read-only. Returns 0 on success, -1 if the file
+ * cannot be opened, is not a matrix file or is shorter than its header says.
+ */
+static inline int matfile_open(const char *path, matfile *f)
+{
+    matfile_header h;
+    struct stat st;
+    memset(f, 0, sizeof(*f));
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0)
+        return -1;
+    if (pread(f->fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || h.magic != MATFILE_MAGIC ||
+        h.version != MATFILE_VERSION || fstat(f->fd, &st) != 0 ||
+        (size_t)st.st_size < MATFILE_HEADER + sizeof(double) * (size_t)h.m * (size_t)h.n)
+    {
+        close(f->fd);
+        return -1;
+    }
+    f->m = h.m;
+    f->n = h.n;
+    f->size = MATFILE_HEADER + sizeof(double) * (size_t)h.m * (size_t)h.n;
+    void *map = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(f->fd);
+        return -1;
+    }
+    f->map = (unsigned char*)map;
+    f->a = (const double*)(f->map + MATFILE_HEADER);
+    madvise(f->map, f->size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+static inline void matfile_close(matfile *f)
+{
+    if (f->map != NULL)
+        munmap(f->map, f->size);
+    if (f->fd >= 0)
+        close(f->fd);
+    memset(f, 0, sizeof(*f));
+    f->fd = -1;
+}
+
+/*
+ * matfile_panel_rows: rows per panel so that a panel takes about panel_bytes.
+ */
+static inline int64_t matfile_panel_rows(const matfile *f, size_t panel_bytes)
+{
+    int64_t rows = (int64_t)(panel_bytes / (sizeof(double) * (size_t)f->n));
+    return rows < 1 ? 1 : rows;
+}
+
+/*
+ * matfile_prefetch: start asynchronous readahead of rows lb <= i < ub.
+ */
+static inline void matfile_prefetch(const matfile *f, int64_t lb, int64_t ub)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = MATFILE_HEADER + sizeof(double) * (size_t)(lb * f->n);
+    size_t end = MATFILE_HEADER + sizeof(double) * (size_t)(ub * f->n);
+    begin -= begin % page;
+    madvise(f->map + begin, end - begin, MADV_WILLNEED);
+}
+
+/*
+ * matfile_release: drop rows lb <= i < ub from the mapping and the page cache.
+ * Only pages lying wholly inside the range are dropped, so a neighbouring panel
+ * still being read keeps its boundary page.
+ */
+static inline void matfile_release(const matfile *f, int64_t lb, int64_t ub)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = MATFILE_HEADER + sizeof(double) * (size_t)(lb * f->n);
+    size_t end = MATFILE_HEADER + sizeof(double) * (size_t)(ub * f->n);
+    begin = (begin + page - 1) / page * page;
+    if (ub < f->m)
+        end -= end % page;
+    if (end <= begin)
+        return;
+    madvise(f->map + begin, end - begin, MADV_DONTNEED);
+    posix_fadvise(f->fd, (off_t)begin, (off_t)(end - begin), POSIX_FADV_DONTNEED);
+}
+
+#endif
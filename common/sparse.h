@@ -0,0 +1,288 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+/*
+ * Sparse matrix formats shared by the lab_2.1 (OpenMP) and lab_3.1 (std::thread)
+ * matvec programs. The kernels here work on a row (or chunk) range; the caller
+ * decides how ranges are split between threads, using the *_partition helpers
+ * that balance work by stored nonzeros instead of by row count.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SELL_MAX_C 32
+
+/*
+ * csr_matrix: compressed sparse row storage, row i owns val/col[row_ptr[i]..row_ptr[i+1]).
+ */
+typedef struct
+{
+    int m, n;
+    size_t nnz;
+    size_t *row_ptr;
+    int *col;
+    double *val;
+} csr_matrix;
+
+/*
+ * sell_matrix: SELL-C-sigma storage. Rows are sorted by length inside windows of
+ * sigma rows, packed into chunks of C rows padded to the longest row of the chunk
+ * and stored column-major inside the chunk. perm[r] is the original row of slot r.
+ */
+typedef struct
+{
+    int m, n, C, nchunks;
+    size_t stored;
+    size_t *chunk_ptr;
+    int *chunk_len;
+    int *perm;
+    int *col;
+    double *val;
+} sell_matrix;
+
+static inline void csr_free(csr_matrix *A)
+{
+    free(A->row_ptr);
+    free(A->col);
+    free(A->val);
+    memset(A, 0, sizeof(*A));
+}
+
+static inline void sell_free(sell_matrix *A)
+{
+    free(A->chunk_ptr);
+    free(A->chunk_len);
+    free(A->perm);
+    free(A->col);
+    free(A->val);
+    memset(A, 0, sizeof(*A));
+}
+
+/*
+ * csr_from_dense: build CSR from the dense row-major a[m][n], dropping exact zeros.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+static inline int csr_from_dense(const double *a, int m, int n, csr_matrix *A)
+{
+    memset(A, 0, sizeof(*A));
+    A->m = m;
+    A->n = n;
+    A->row_ptr = (size_t*)malloc(sizeof(*A->row_ptr) * (m + 1));
+    if (A->row_ptr == NULL)
+        return -1;
+    A->row_ptr[0] = 0;
+    for (int i = 0; i < m; i++)
+    {
+        size_t cnt = 0;
+        for (int j = 0; j < n; j++)
+            cnt += a[(size_t)i * n + j] != 0.0;
+        A->row_ptr[i + 1] = A->row_ptr[i] + cnt;
+    }
+    A->nnz = A->row_ptr[m];
+    A->col = (int*)malloc(sizeof(*A->col) * (A->nnz ? A->nnz : 1));
+    A->val = (double*)malloc(sizeof(*A->val) * (A->nnz ? A->nnz : 1));
+    if (A->col == NULL || A->val == NULL)
+    {
+        csr_free(A);
+        return -1;
+    }
+    for (int i = 0; i < m; i++)
+    {
+        size_t k = A->row_ptr[i];
+        for (int j = 0; j < n; j++)
+        {
+            double v = a[(size_t)i * n + j];
+            if (v != 0.0)
+            {
+                A->col[k] = j;
+                A->val[k] = v;
+                k++;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * balanced_partition: split [0, count) into nparts ranges with roughly equal
+ * weight, where prefix[i] is the total weight of items before i. bounds gets
+ * nparts + 1 entries.
+ */
+static inline void balanced_partition(const size_t *prefix, int count, int nparts, int *bounds)
+{
+    size_t total = prefix[count];
+    bounds[0] = 0;
+    for (int p = 1; p < nparts; p++)
+    {
+        size_t target = total / nparts * p + total % nparts * p / nparts;
+        int lo = bounds[p - 1], hi = count;
+        while (lo < hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+            if (prefix[mid] < target)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        bounds[p] = lo;
+    }
+    bounds[nparts] = count;
+}
+
+static inline void csr_partition(const csr_matrix *A, int nparts, int *bounds)
+{
+    balanced_partition(A->row_ptr, A->m, nparts, bounds);
+}
+
+/*
+ * csr_spmv_rows: y[i] = sum_k val[k] * x[col[k]] for rows lb <= i < ub.
+ */
+static inline void csr_spmv_rows(const csr_matrix *A, const double *x, double *y, int lb, int ub)
+{
+    for (int i = lb; i < ub; i++)
+    {
+        double s = 0.0;
+        for (size_t k = A->row_ptr[i]; k < A->row_ptr[i + 1]; k++)
+            s += A->val[k] * x[A->col[k]];
+        y[i] = s;
+    }
+}
+
+typedef struct
+{
+    size_t len;
+    int row;
+} sell_row_key;
+
+static inline int sell_row_key_cmp(const void *l, const void *r)
+{
+    const sell_row_key *a = (const sell_row_key*)l;
+    const sell_row_key *b = (const sell_row_key*)r;
+    if (a->len != b->len)
+        return a->len > b->len ? -1 : 1;
+    return a->row - b->row;
+}
+
+/*
+ * sell_from_csr: build SELL-C-sigma from CSR. C is clamped to [1, SELL_MAX_C] and
+ * sigma is rounded up to a multiple of C. Returns 0 on success, -1 if memory could
+ * not be allocated.
+ */
+static inline int sell_from_csr(const csr_matrix *A, int C, int sigma, sell_matrix *S)
+{
+    memset(S, 0, sizeof(*S));
+    if (C < 1)
+        C = 1;
+    if (C > SELL_MAX_C)
+        C = SELL_MAX_C;
+    if (sigma < C)
+        sigma = C;
+    sigma = (sigma + C - 1) / C * C;
+    S->m = A->m;
+    S->n = A->n;
+    S->C = C;
+    S->nchunks = (A->m + C - 1) / C;
+    S->chunk_ptr = (size_t*)malloc(sizeof(*S->chunk_ptr) * (S->nchunks + 1));
+    S->chunk_len = (int*)malloc(sizeof(*S->chunk_len) * (S->nchunks ? S->nchunks : 1));
+    S->perm = (int*)malloc(sizeof(*S->perm) * (size_t)S->nchunks * C + 1);
+    sell_row_key *keys = (sell_row_key*)malloc(sizeof(*keys) * (A->m ? A->m : 1));
+    if (S->chunk_ptr == NULL || S->chunk_len == NULL || S->perm == NULL || keys == NULL)
+    {
+        free(keys);
+        sell_free(S);
+        return -1;
+    }
+
+    for (int i = 0; i < A->m; i++)
+    {
+        keys[i].len = A->row_ptr[i + 1] - A->row_ptr[i];
+        keys[i].row = i;
+    }
+    for (int w = 0; w < A->m; w += sigma)
+    {
+        int cnt = (w + sigma < A->m) ? sigma : A->m - w;
+        qsort(keys + w, cnt, sizeof(*keys), sell_row_key_cmp);
+    }
+
+    S->chunk_ptr[0] = 0;
+    for (int ch = 0; ch < S->nchunks; ch++)
+    {
+        size_t len = 0;
+        for (int r = 0; r < C; r++)
+        {
+            int slot = ch * C + r;
+            S->perm[slot] = slot < A->m ? keys[slot].row : -1;
+            if (slot < A->m && keys[slot].len > len)
+                len = keys[slot].len;
+        }
+        S->chunk_len[ch] = (int)len;
+        S->chunk_ptr[ch + 1] = S->chunk_ptr[ch] + len * C;
+    }
+    free(keys);
+
+    S->stored = S->chunk_ptr[S->nchunks];
+    S->col = (int*)malloc(sizeof(*S->col) * (S->stored ? S->stored : 1));
+    S->val = (double*)malloc(sizeof(*S->val) * (S->stored ? S->stored : 1));
+    if (S->col == NULL || S->val == NULL)
+    {
+        sell_free(S);
+        return -1;
+    }
+    for (int ch = 0; ch < S->nchunks; ch++)
+    {
+        for (int r = 0; r < C; r++)
+        {
+            int row = S->perm[ch * C + r];
+            size_t rlen = row >= 0 ? A->row_ptr[row + 1] - A->row_ptr[row] : 0;
+            for (int k = 0; k < S->chunk_len[ch]; k++)
+            {
+                size_t idx = S->chunk_ptr[ch] + (size_t)k * C + r;
+                if ((size_t)k < rlen)
+                {
+                    S->col[idx] = A->col[A->row_ptr[row] + k];
+                    S->val[idx] = A->val[A->row_ptr[row] + k];
+                }
+                else
+                {
+                    S->col[idx] = 0;
+                    S->val[idx] = 0.0;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static inline void sell_partition(const sell_matrix *S, int nparts, int *bounds)
+{
+    balanced_partition(S->chunk_ptr, S->nchunks, nparts, bounds);
+}
+
+/*
+ * sell_spmv_chunks: y = A * x for chunks cb <= ch < ce. The C rows of a chunk
+ * are updated together, which is the loop the compiler vectorizes.
+ */
+static inline void sell_spmv_chunks(const sell_matrix *S, const double *x, double *y, int cb, int ce)
+{
+    const int C = S->C;
+    double acc[SELL_MAX_C];
+    for (int ch = cb; ch < ce; ch++)
+    {
+        const double *val = S->val + S->chunk_ptr[ch];
+        const int *col = S->col + S->chunk_ptr[ch];
+        for (int r = 0; r < C; r++)
+            acc[r] = 0.0;
+        for (int k = 0; k < S->chunk_len[ch]; k++)
+            for (int r = 0; r < C; r++)
+                acc[r] += val[(size_t)k * C + r] * x[col[(size_t)k * C + r]];
+        for (int r = 0; r < C; r++)
+        {
+            int row = S->perm[ch * C + r];
+            if (row >= 0)
+                y[row] = acc[r];
+        }
+    }
+}
+
+#endif
@@ -1,7 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include <omp.h>
+#include <immintrin.h>
+
+#include "../../common/bench.h"
+#include "../../common/sparse.h"
+#include "../../common/matfile.h"
+#include "../../common/alloc.h"
 
 
 double cpuSecond()
@@ -42,6 +51,566 @@ void matrix_vector_product_omp(double *a, double *b, double *c, int m, int n)
     }
 }
 
+/*
+ * Row-range kernels for matrix_vector_product_simd: compute c[i] for lb <= i < ub.
+ * Four rows are processed at once so every load of b[j] feeds four independent
+ * accumulators that stay in registers for the whole row.
+ */
+typedef void (*matvec_kernel_t)(const double *a, const double *b, double *c, int n, int lb, int ub);
+
+static void matvec_rows_scalar(const double *a, const double *b, double *c, int n, int lb, int ub)
+{
+    int i = lb;
+    for (; i + 3 < ub; i += 4)
+    {
+        const double *a0 = a + (size_t)i * n;
+        const double *a1 = a0 + n;
+        const double *a2 = a1 + n;
+        const double *a3 = a2 + n;
+        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        for (int j = 0; j < n; j++)
+        {
+            double bj = b[j];
+            s0 += a0[j] * bj;
+            s1 += a1[j] * bj;
+            s2 += a2[j] * bj;
+            s3 += a3[j] * bj;
+        }
+        c[i] = s0;
+        c[i + 1] = s1;
+        c[i + 2] = s2;
+        c[i + 3] = s3;
+    }
+    for (; i < ub; i++)
+    {
+        const double *ai = a + (size_t)i * n;
+        double s = 0.0;
+        for (int j = 0; j < n; j++)
+            s += ai[j] * b[j];
+        c[i] = s;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static double hsum_avx2(__m256d v)
+{
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2,fma")))
+static void matvec_rows_avx2(const double *a, const double *b, double *c, int n, int lb, int ub)
+{
+    int i = lb;
+    for (; i + 3 < ub; i += 4)
+    {
+        const double *a0 = a + (size_t)i * n;
+        const double *a1 = a0 + n;
+        const double *a2 = a1 + n;
+        const double *a3 = a2 + n;
+        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+        __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+        int j = 0;
+        for (; j + 3 < n; j += 4)
+        {
+            __m256d bj = _mm256_loadu_pd(b + j);
+            s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + j), bj, s0);
+            s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a1 + j), bj, s1);
+            s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a2 + j), bj, s2);
+            s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a3 + j), bj, s3);
+        }
+        double r0 = hsum_avx2(s0), r1 = hsum_avx2(s1), r2 = hsum_avx2(s2), r3 = hsum_avx2(s3);
+        for (; j < n; j++)
+        {
+            r0 += a0[j] * b[j];
+            r1 += a1[j] * b[j];
+            r2 += a2[j] * b[j];
+            r3 += a3[j] * b[j];
+        }
+        c[i] = r0;
+        c[i + 1] = r1;
+        c[i + 2] = r2;
+        c[i + 3] = r3;
+    }
+    for (; i < ub; i++)
+    {
+        const double *ai = a + (size_t)i * n;
+        __m256d s = _mm256_setzero_pd();
+        int j = 0;
+        for (; j + 3 < n; j += 4)
+            s = _mm256_fmadd_pd(_mm256_loadu_pd(ai + j), _mm256_loadu_pd(b + j), s);
+        double r = hsum_avx2(s);
+        for (; j < n; j++)
+            r += ai[j] * b[j];
+        c[i] = r;
+    }
+}
+
+/*
+ * hsum_avx512: sum of the eight lanes (through memory: _mm512_reduce_add_pd
+ * trips gcc 12's -Wmaybe-uninitialized on its undefined upper half).
+ */
+__attribute__((target("avx512f")))
+static inline double hsum_avx512(__m512d s)
+{
+    double t[8];
+    _mm512_storeu_pd(t, s);
+    return ((t[0] + t[4]) + (t[1] + t[5])) + ((t[2] + t[6]) + (t[3] + t[7]));
+}
+
+__attribute__((target("avx512f")))
+static void matvec_rows_avx512(const double *a, const double *b, double *c, int n, int lb, int ub)
+{
+    int i = lb;
+    for (; i + 3 < ub; i += 4)
+    {
+        const double *a0 = a + (size_t)i * n;
+        const double *a1 = a0 + n;
+        const double *a2 = a1 + n;
+        const double *a3 = a2 + n;
+        __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+        __m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+        int j = 0;
+        for (; j + 7 < n; j += 8)
+        {
+            __m512d bj = _mm512_loadu_pd(b + j);
+            s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a0 + j), bj, s0);
+            s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a1 + j), bj, s1);
+            s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a2 + j), bj, s2);
+            s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a3 + j), bj, s3);
+        }
+        if (j < n)
+        {
+            __mmask8 k = (__mmask8)((1u << (n - j)) - 1);
+            __m512d bj = _mm512_maskz_loadu_pd(k, b + j);
+            s0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a0 + j), bj, s0);
+            s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a1 + j), bj, s1);
+            s2 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a2 + j), bj, s2);
+            s3 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a3 + j), bj, s3);
+        }
+        c[i] = hsum_avx512(s0);
+        c[i + 1] = hsum_avx512(s1);
+        c[i + 2] = hsum_avx512(s2);
+        c[i + 3] = hsum_avx512(s3);
+    }
+    for (; i < ub; i++)
+    {
+        const double *ai = a + (size_t)i * n;
+        __m512d s = _mm512_setzero_pd();
+        int j = 0;
+        for (; j + 7 < n; j += 8)
+            s = _mm512_fmadd_pd(_mm512_loadu_pd(ai + j), _mm512_loadu_pd(b + j), s);
+        if (j < n)
+        {
+            __mmask8 k = (__mmask8)((1u << (n - j)) - 1);
+            s = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, ai + j), _mm512_maskz_loadu_pd(k, b + j), s);
+        }
+        c[i] = hsum_avx512(s);
+    }
+}
+
+/*
+ * select_matvec_kernel: pick the widest kernel the CPU supports.
+ * MATVEC_ISA=scalar|avx2|avx512 in the environment caps the choice.
+ */
+static matvec_kernel_t select_matvec_kernel(const char **name)
+{
+    const char *isa = getenv("MATVEC_ISA");
+    int allow512 = isa == NULL || strcmp(isa, "avx512") == 0;
+    int allow2 = allow512 || strcmp(isa, "avx2") == 0;
+
+    __builtin_cpu_init();
+    if (allow512 && __builtin_cpu_supports("avx512f"))
+    {
+        *name = "avx512";
+        return matvec_rows_avx512;
+    }
+    if (allow2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        *name = "avx2";
+        return matvec_rows_avx2;
+    }
+    *name = "scalar";
+    return matvec_rows_scalar;
+}
+
+/*
+ * matrix_vector_product_simd: c[m] = a[m][n] * b[n], rows split between threads
+ * in blocks of four, inner loop vectorized by the kernel chosen at runtime.
+ */
+void matrix_vector_product_simd(double *a, double *b, double *c, int m, int n)
+{
+    const char *name;
+    matvec_kernel_t kernel = select_matvec_kernel(&name);
+#pragma omp parallel
+    {
+        int nthreads = omp_get_num_threads();
+        int threadid = omp_get_thread_num();
+        int blocks = (m + 3) / 4;
+        int blocks_per_thread = blocks / nthreads;
+        int extra = blocks % nthreads;
+        int lb = 4 * (threadid * blocks_per_thread + (threadid < extra ? threadid : extra));
+        int ub = lb + 4 * (blocks_per_thread + (threadid < extra ? 1 : 0));
+        if (ub > m)
+            ub = m;
+        if (lb < ub)
+            kernel(a, b, c, n, lb, ub);
+    }
+}
+
+/*
+ * max_rel_error: largest |c[i] - ref[i]| / |ref[i]| over the vector.
+ */
+double max_rel_error(const double *c, const double *ref, int m)
+{
+    double err = 0.0;
+    for (int i = 0; i < m; i++)
+    {
+        double d = fabs(c[i] - ref[i]);
+        if (ref[i] != 0.0)
+            d /= fabs(ref[i]);
+        if (d > err)
+            err = d;
+    }
+    return err;
+}
+
+/*
+ * matrix_vector_product_batch: C[m][k] = a[m][n] * B[n][k] for k right-hand sides
+ * at once. B and C are stored row-major, so the k values for one j (or one i) are
+ * contiguous and the inner loop over them vectorizes. Columns of a are tiled so the
+ * B panel a thread reuses across its rows stays in cache; every a[i][j] is read once.
+ */
+void matrix_vector_product_batch(double *a, double *B, double *C, int m, int n, int k)
+{
+    int tile = (32 * 1024) / (k > 0 ? k : 1);
+    if (tile < 64)
+        tile = 64;
+#pragma omp parallel
+    {
+        int nthreads = omp_get_num_threads();
+        int threadid = omp_get_thread_num();
+        int items_per_thread = m / nthreads;
+        int lb = threadid * items_per_thread;
+        int ub = (threadid == nthreads - 1) ? (m - 1) : (lb + items_per_thread - 1);
+        for (int i = lb; i <= ub; i++)
+            for (int v = 0; v < k; v++)
+                C[(size_t)i * k + v] = 0.0;
+        for (int jb = 0; jb < n; jb += tile)
+        {
+            int je = (jb + tile < n) ? jb + tile : n;
+            for (int i = lb; i <= ub; i++)
+            {
+                const double *ai = a + (size_t)i * n;
+                double *ci = C + (size_t)i * k;
+                for (int j = jb; j < je; j++)
+                {
+                    const double aij = ai[j];
+                    const double *bj = B + (size_t)j * k;
+                    #pragma omp simd
+                    for (int v = 0; v < k; v++)
+                        ci[v] += aij * bj[v];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Reduced-precision storage for a: float, bf16 or fp16 elements, converted to
+ * float on the fly and accumulated in float. b is kept as a float copy.
+ */
+typedef enum { STORE_F32, STORE_BF16, STORE_F16 } storage_t;
+
+static const char *storage_names[] = {"float", "bf16", "fp16"};
+static const size_t storage_sizes[] = {sizeof(float), sizeof(uint16_t), sizeof(uint16_t)};
+/* unit roundoff of each storage format */
+static const double storage_eps[] = {5.96e-8, 3.91e-3, 4.88e-4};
+
+static uint16_t float_to_bf16(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    x += 0x7fff + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+}
+
+static float bf16_to_float(uint16_t h)
+{
+    uint32_t x = (uint32_t)h << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static uint16_t float_to_fp16(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int exp = (int)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+    if (((x >> 23) & 0xff) == 0xff)
+        return (uint16_t)(sign | 0x7c00 | (mant ? 0x200 : 0));
+    if (exp >= 31)
+        return (uint16_t)(sign | 0x7c00);
+    if (exp <= 0)
+    {
+        if (exp < -10)
+            return (uint16_t)sign;
+        mant |= 0x800000;
+        uint32_t shift = 14 - exp;
+        uint32_t h = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1)))
+            h++;
+        return (uint16_t)(sign | h);
+    }
+    uint32_t h = ((uint32_t)exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+        h++;
+    return (uint16_t)(sign | h);
+}
+
+static float fp16_to_float(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0)
+    {
+        if (mant == 0)
+            x = sign;
+        else
+        {
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400))
+            {
+                mant <<= 1;
+                exp--;
+            }
+            x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+    }
+    else if (exp == 31)
+        x = sign | 0x7f800000 | (mant << 13);
+    else
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/*
+ * matrix_convert: copy a[m][n] into a new buffer in the given format.
+ * Rows are converted by the same static partition the kernels use.
+ */
+void *matrix_convert(const double *a, int m, int n, storage_t fmt)
+{
+    void *dst = malloc(storage_sizes[fmt] * (size_t)m * n);
+    if (dst == NULL)
+        return NULL;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < m; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            size_t idx = (size_t)i * n + j;
+            if (fmt == STORE_F32)
+                ((float*)dst)[idx] = (float)a[idx];
+            else if (fmt == STORE_BF16)
+                ((uint16_t*)dst)[idx] = float_to_bf16((float)a[idx]);
+            else
+                ((uint16_t*)dst)[idx] = float_to_fp16((float)a[idx]);
+        }
+    }
+    return dst;
+}
+
+typedef void (*matvec_lowp_kernel_t)(const void *a, const float *b, double *c, int n, int lb, int ub);
+
+static void matvec_lowp_scalar(const void *a, const float *b, double *c, int n, int lb, int ub, storage_t fmt)
+{
+    for (int i = lb; i < ub; i++)
+    {
+        size_t row = (size_t)i * n;
+        float s = 0.0f;
+        for (int j = 0; j < n; j++)
+        {
+            float aij;
+            if (fmt == STORE_F32)
+                aij = ((const float*)a)[row + j];
+            else if (fmt == STORE_BF16)
+                aij = bf16_to_float(((const uint16_t*)a)[row + j]);
+            else
+                aij = fp16_to_float(((const uint16_t*)a)[row + j]);
+            s += aij * b[j];
+        }
+        c[i] = s;
+    }
+}
+
+static void matvec_f32_scalar(const void *a, const float *b, double *c, int n, int lb, int ub)
+{
+    matvec_lowp_scalar(a, b, c, n, lb, ub, STORE_F32);
+}
+
+static void matvec_bf16_scalar(const void *a, const float *b, double *c, int n, int lb, int ub)
+{
+    matvec_lowp_scalar(a, b, c, n, lb, ub, STORE_BF16);
+}
+
+static void matvec_f16_scalar(const void *a, const float *b, double *c, int n, int lb, int ub)
+{
+    matvec_lowp_scalar(a, b, c, n, lb, ub, STORE_F16);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static inline __m256 load8_f32(const void *a, size_t idx)
+{
+    return _mm256_loadu_ps((const float*)a + idx);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static inline __m256 load8_bf16(const void *a, size_t idx)
+{
+    __m128i h = _mm_loadu_si128((const __m128i*)((const uint16_t*)a + idx));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static inline __m256 load8_f16(const void *a, size_t idx)
+{
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)((const uint16_t*)a + idx)));
+}
+
+/*
+ * AVX2 row kernel for one storage format: 16 elements per step into two float
+ * accumulators, conversion to float happens right after the load.
+ */
+#define DEFINE_MATVEC_LOWP_AVX2(name, load, fmt) \
+__attribute__((target("avx2,fma,f16c"))) \
+static void name(const void *a, const float *b, double *c, int n, int lb, int ub) \
+{ \
+    for (int i = lb; i < ub; i++) \
+    { \
+        size_t row = (size_t)i * n; \
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(); \
+        int j = 0; \
+        for (; j + 15 < n; j += 16) \
+        { \
+            s0 = _mm256_fmadd_ps(load(a, row + j), _mm256_loadu_ps(b + j), s0); \
+            s1 = _mm256_fmadd_ps(load(a, row + j + 8), _mm256_loadu_ps(b + j + 8), s1); \
+        } \
+        s0 = _mm256_add_ps(s0, s1); \
+        __m128 q = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1)); \
+        q = _mm_add_ps(q, _mm_movehl_ps(q, q)); \
+        q = _mm_add_ss(q, _mm_shuffle_ps(q, q, 1)); \
+        double r = _mm_cvtss_f32(q); \
+        if (j < n) \
+        { \
+            double t; \
+            matvec_lowp_scalar((const char*)a + storage_sizes[fmt] * (row + j), b + j, &t, n - j, 0, 1, fmt); \
+            r += t; \
+        } \
+        c[i] = r; \
+    } \
+}
+
+DEFINE_MATVEC_LOWP_AVX2(matvec_f32_avx2, load8_f32, STORE_F32)
+DEFINE_MATVEC_LOWP_AVX2(matvec_bf16_avx2, load8_bf16, STORE_BF16)
+DEFINE_MATVEC_LOWP_AVX2(matvec_f16_avx2, load8_f16, STORE_F16)
+
+static matvec_lowp_kernel_t select_matvec_lowp_kernel(storage_t fmt, const char **name)
+{
+    static const matvec_lowp_kernel_t avx2[] = {matvec_f32_avx2, matvec_bf16_avx2, matvec_f16_avx2};
+    static const matvec_lowp_kernel_t scalar[] = {matvec_f32_scalar, matvec_bf16_scalar, matvec_f16_scalar};
+    const char *isa = getenv("MATVEC_ISA");
+
+    __builtin_cpu_init();
+    if ((isa == NULL || strcmp(isa, "scalar") != 0) && __builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+    {
+        *name = "avx2";
+        return avx2[fmt];
+    }
+    *name = "scalar";
+    return scalar[fmt];
+}
+
+/*
+ * matrix_vector_product_lowp: c[m] = a[m][n] * b[n] with a stored in fmt.
+ */
+void matrix_vector_product_lowp(const void *a, storage_t fmt, const float *b, double *c, int m, int n)
+{
+    const char *name;
+    matvec_lowp_kernel_t kernel = select_matvec_lowp_kernel(fmt, &name);
+#pragma omp parallel
+    {
+        int nthreads = omp_get_num_threads();
+        int threadid = omp_get_thread_num();
+        int items_per_thread = m / nthreads;
+        int extra = m % nthreads;
+        int lb = threadid * items_per_thread + (threadid < extra ? threadid : extra);
+        int ub = lb + items_per_thread + (threadid < extra ? 1 : 0);
+        if (lb < ub)
+            kernel(a, b, c, n, lb, ub);
+    }
+}
+
+/*
+ * matrix_vector_product_csr: c = A * b, each thread gets a row range holding
+ * about the same number of nonzeros.
+ */
+void matrix_vector_product_csr(const csr_matrix *A, double *b, double *c)
+{
+#pragma omp parallel
+    {
+        int nthreads = omp_get_num_threads();
+        int threadid = omp_get_thread_num();
+        int bounds[nthreads + 1];
+        csr_partition(A, nthreads, bounds);
+        csr_spmv_rows(A, b, c, bounds[threadid], bounds[threadid + 1]);
+    }
+}
+
+/*
+ * matrix_vector_product_sell: c = A * b over SELL-C-sigma chunks, balanced by
+ * stored (padded) entries.
+ */
+void matrix_vector_product_sell(const sell_matrix *A, double *b, double *c)
+{
+#pragma omp parallel
+    {
+        int nthreads = omp_get_num_threads();
+        int threadid = omp_get_thread_num();
+        int bounds[nthreads + 1];
+        sell_partition(A, nthreads, bounds);
+        sell_spmv_chunks(A, b, c, bounds[threadid], bounds[threadid + 1]);
+    }
+}
+
+/*
+ * sparse_entry: deterministic test pattern with density falling linearly from
+ * 2 * density in the first row to 0 in the last, plus the diagonal, so equal
+ * row counts do not mean equal work.
+ */
+static int sparse_entry(int i, int j, int m, double density)
+{
+    if (i == j)
+        return 1;
+    uint32_t h = (uint32_t)i * 2654435761u ^ (uint32_t)j * 2246822519u;
+    h ^= h >> 15;
+    h *= 2654435761u;
+    h ^= h >> 13;
+    return h < density * 2.0 * (1.0 - (double)i / m) * 4294967295.0;
+}
+
 void run_serial(size_t n, size_t m)
 {
     double *a, *b, *c;
@@ -80,15 +649,15 @@ void run_serial(size_t n, size_t m)
 void run_parallel(size_t n, size_t m) {
      double *a, *b, *c;
 
-    a = (double*)malloc(sizeof(*a) * m * n);
-    b = (double*)malloc(sizeof(*b) * n);
-    c = (double*)malloc(sizeof(*c) * m);
+    a = (double*)kernel_alloc(sizeof(*a) * m * n);
+    b = (double*)kernel_alloc(sizeof(*b) * n);
+    c = (double*)kernel_alloc(sizeof(*c) * m);
 
     if (a == NULL || b == NULL || c == NULL)
         {
-            free(a);
-            free(b);
-            free(c);
+            kernel_free(a);
+            kernel_free(b);
+            kernel_free(c);
             printf("Error allocate memory!\n");
             exit(1);
         }
@@ -109,16 +678,457 @@ void run_parallel(size_t n, size_t m) {
     for (int j = 0; j < n; j++)
         b[j] = j;
 
+    int *tlb = kernel_alloc_stats() ? tlb_team_open(omp_get_max_threads()) : NULL;
     double t = cpuSecond();
     matrix_vector_product_omp(a, b, c, m, n);
     t = cpuSecond() - t;
 
     printf("Elapsed time (parallel): %.6f sec.\n", t);
+    if (kernel_alloc_stats())
+    {
+        huge_report("a", a, sizeof(*a) * m * n);
+        printf("dTLB load misses: %lld\n", tlb_team_close(tlb, omp_get_max_threads()));
+    }
+    kernel_free(a);
+    kernel_free(b);
+    kernel_free(c);
+}
+
+void run_parallel_simd(size_t n, size_t m)
+{
+    double *a, *b, *c, *ref;
+
+    a = (double*)kernel_alloc(sizeof(*a) * m * n);
+    b = (double*)kernel_alloc(sizeof(*b) * n);
+    c = (double*)kernel_alloc(sizeof(*c) * m);
+    ref = (double*)malloc(sizeof(*ref) * m);
+
+    if (a == NULL || b == NULL || c == NULL || ref == NULL)
+    {
+        kernel_free(a);
+        kernel_free(b);
+        kernel_free(c);
+        free(ref);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < (int)m; i++)
+    {
+        for (int j = 0; j < (int)n; j++)
+            a[i * n + j] = i + j;
+        c[i] = 0.0;
+    }
+    for (int j = 0; j < (int)n; j++)
+        b[j] = j;
+
+    const char *name;
+    select_matvec_kernel(&name);
+
+    int *tlb = kernel_alloc_stats() ? tlb_team_open(omp_get_max_threads()) : NULL;
+    double t = cpuSecond();
+    matrix_vector_product_simd(a, b, c, m, n);
+    t = cpuSecond() - t;
+    long long misses = tlb_team_close(tlb, omp_get_max_threads());
+
+    matrix_vector_product(a, b, ref, m, n);
+    printf("Elapsed time (parallel simd, %s): %.6f sec.\n", name, t);
+    printf("Max relative error vs serial: %.3e\n", max_rel_error(c, ref, m));
+    if (kernel_alloc_stats())
+    {
+        huge_report("a", a, sizeof(*a) * m * n);
+        printf("dTLB load misses: %lld\n", misses);
+    }
+    kernel_free(a);
+    kernel_free(b);
+    kernel_free(c);
+    free(ref);
+}
+
+void run_parallel_batch(size_t n, size_t m, int k)
+{
+    double *a, *B, *C, *b, *c;
+
+    a = (double*)malloc(sizeof(*a) * m * n);
+    B = (double*)malloc(sizeof(*B) * n * k);
+    C = (double*)malloc(sizeof(*C) * m * k);
+    b = (double*)malloc(sizeof(*b) * n);
+    c = (double*)malloc(sizeof(*c) * m);
+
+    if (a == NULL || B == NULL || C == NULL || b == NULL || c == NULL)
+    {
+        free(a);
+        free(B);
+        free(C);
+        free(b);
+        free(c);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < (int)m; i++)
+        for (int j = 0; j < (int)n; j++)
+            a[i * n + j] = i + j;
+    for (int j = 0; j < (int)n; j++)
+        for (int v = 0; v < k; v++)
+            B[(size_t)j * k + v] = j + v;
+
+    double t_batch = cpuSecond();
+    matrix_vector_product_batch(a, B, C, m, n, k);
+    t_batch = cpuSecond() - t_batch;
+
+    /* Same k products through the single-vector path, one full pass over a each. */
+    double t_single = 0.0, err = 0.0;
+    for (int v = 0; v < k; v++)
+    {
+        for (int j = 0; j < (int)n; j++)
+            b[j] = B[(size_t)j * k + v];
+        double t = cpuSecond();
+        matrix_vector_product_omp(a, b, c, m, n);
+        t_single += cpuSecond() - t;
+        for (int i = 0; i < (int)m; i++)
+        {
+            double d = fabs(c[i] - C[(size_t)i * k + v]);
+            if (c[i] != 0.0)
+                d /= fabs(c[i]);
+            if (d > err)
+                err = d;
+        }
+    }
+
+    double flops = 2.0 * m * n * k;
+    double bytes_batch = sizeof(double) * ((double)m * n + (double)n * k + (double)m * k);
+    double bytes_single = k * sizeof(double) * ((double)m * n + n + m);
+    printf("Batch of %d vectors:\n", k);
+    printf("Elapsed time (single x%d): %.6f sec, %.3f GFLOP/s, %.3f bytes/flop\n",
+           k, t_single, flops / t_single * 1.e-9, bytes_single / flops);
+    printf("Elapsed time (batch): %.6f sec, %.3f GFLOP/s, %.3f bytes/flop\n",
+           t_batch, flops / t_batch * 1.e-9, bytes_batch / flops);
+    printf("Speedup: %.2f; max relative error vs single: %.3e\n", t_single / t_batch, err);
+    free(a);
+    free(B);
+    free(C);
+    free(b);
+    free(c);
+}
+
+void run_parallel_lowp(size_t n, size_t m, storage_t fmt)
+{
+    double *a, *b, *c, *ref;
+    float *bf;
+
+    a = (double*)malloc(sizeof(*a) * m * n);
+    b = (double*)malloc(sizeof(*b) * n);
+    bf = (float*)malloc(sizeof(*bf) * n);
+    c = (double*)malloc(sizeof(*c) * m);
+    ref = (double*)malloc(sizeof(*ref) * m);
+
+    if (a == NULL || b == NULL || bf == NULL || c == NULL || ref == NULL)
+    {
+        free(a);
+        free(b);
+        free(bf);
+        free(c);
+        free(ref);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < (int)m; i++)
+        for (int j = 0; j < (int)n; j++)
+            a[i * n + j] = i + j;
+    for (int j = 0; j < (int)n; j++)
+    {
+        b[j] = j;
+        bf[j] = (float)j;
+    }
+    if (fmt == STORE_F16 && m + n - 2 > 65504)
+        printf("Warning: matrix values exceed the fp16 range\n");
+
+    void *alow = matrix_convert(a, m, n, fmt);
+    if (alow == NULL)
+    {
+        free(a);
+        free(b);
+        free(bf);
+        free(c);
+        free(ref);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+
+    double t_double = cpuSecond();
+    matrix_vector_product_simd(a, b, ref, m, n);
+    t_double = cpuSecond() - t_double;
+
+    const char *name;
+    select_matvec_lowp_kernel(fmt, &name);
+    double t = cpuSecond();
+    matrix_vector_product_lowp(alow, fmt, bf, c, m, n);
+    t = cpuSecond() - t;
+
+    matrix_vector_product(a, b, ref, m, n);
+    /* first-order bound: storage rounding of a and b plus float accumulation over n terms */
+    double bound = storage_eps[fmt] + storage_eps[STORE_F32] * (1.0 + n);
+
+    printf("Elapsed time (parallel double): %.6f sec, %.1f MB streamed\n",
+           t_double, sizeof(double) * (double)m * n * 1.e-6);
+    printf("Elapsed time (parallel %s, %s): %.6f sec, %.1f MB streamed\n",
+           storage_names[fmt], name, t, storage_sizes[fmt] * (double)m * n * 1.e-6);
+    printf("Speedup: %.2f\n", t_double / t);
+    printf("Max relative error vs serial: %.3e (bound %.3e)\n", max_rel_error(c, ref, m), bound);
+    free(alow);
+    free(a);
+    free(b);
+    free(bf);
+    free(c);
+    free(ref);
+}
+
+void run_parallel_sparse(size_t n, size_t m, double density)
+{
+    double *a, *b, *c, *ref;
+    csr_matrix A;
+    sell_matrix S;
+
+    a = (double*)malloc(sizeof(*a) * m * n);
+    b = (double*)malloc(sizeof(*b) * n);
+    c = (double*)malloc(sizeof(*c) * m);
+    ref = (double*)malloc(sizeof(*ref) * m);
+
+    if (a == NULL || b == NULL || c == NULL || ref == NULL)
+    {
+        free(a);
+        free(b);
+        free(c);
+        free(ref);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < (int)m; i++)
+        for (int j = 0; j < (int)n; j++)
+            a[i * n + j] = sparse_entry(i, j, m, density) ? i + j + 1 : 0.0;
+    for (int j = 0; j < (int)n; j++)
+        b[j] = j;
+
+    double t_conv = cpuSecond();
+    if (csr_from_dense(a, m, n, &A) != 0 || sell_from_csr(&A, 8, 256, &S) != 0)
+    {
+        free(a);
+        free(b);
+        free(c);
+        free(ref);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+    t_conv = cpuSecond() - t_conv;
+    matrix_vector_product(a, b, ref, m, n);
+
+    double t_dense = cpuSecond();
+    matrix_vector_product_omp(a, b, c, m, n);
+    t_dense = cpuSecond() - t_dense;
+
+    double t_simd = cpuSecond();
+    matrix_vector_product_simd(a, b, c, m, n);
+    t_simd = cpuSecond() - t_simd;
+
+    double t_csr = cpuSecond();
+    matrix_vector_product_csr(&A, b, c);
+    t_csr = cpuSecond() - t_csr;
+    double err_csr = max_rel_error(c, ref, m);
+
+    double t_sell = cpuSecond();
+    matrix_vector_product_sell(&S, b, c);
+    t_sell = cpuSecond() - t_sell;
+    double err_sell = max_rel_error(c, ref, m);
+
+    printf("Sparse matrix: nnz = %zu (%.3f%%), conversion %.6f sec.\n",
+           A.nnz, 100.0 * A.nnz / ((double)m * n), t_conv);
+    printf("Memory: dense %.1f MB, CSR %.1f MB, SELL-8-256 %.1f MB (fill %.2f)\n",
+           sizeof(double) * (double)m * n * 1.e-6,
+           ((sizeof(double) + sizeof(int)) * (double)A.nnz + sizeof(size_t) * (m + 1.0)) * 1.e-6,
+           ((sizeof(double) + sizeof(int)) * (double)S.stored + sizeof(int) * (double)m) * 1.e-6,
+           A.nnz ? (double)S.stored / A.nnz : 1.0);
+    printf("Elapsed time (parallel dense): %.6f sec.\n", t_dense);
+    printf("Elapsed time (parallel simd): %.6f sec.\n", t_simd);
+    printf("Elapsed time (parallel csr): %.6f sec, speedup vs dense %.2f\n", t_csr, t_dense / t_csr);
+    printf("Elapsed time (parallel sell): %.6f sec, speedup vs dense %.2f\n", t_sell, t_dense / t_sell);
+    printf("Max relative error vs serial: csr %.3e, sell %.3e\n", err_csr, err_sell);
+    csr_free(&A);
+    sell_free(&S);
+    free(a);
+    free(b);
+    free(c);
+    free(ref);
+}
+
+typedef struct
+{
+    double *a, *b, *c;
+    int m, n;
+} matvec_args;
+
+static void bench_serial(void *p)
+{
+    matvec_args *x = (matvec_args*)p;
+    matrix_vector_product(x->a, x->b, x->c, x->m, x->n);
+}
+
+static void bench_omp(void *p)
+{
+    matvec_args *x = (matvec_args*)p;
+    matrix_vector_product_omp(x->a, x->b, x->c, x->m, x->n);
+}
+
+static void bench_simd(void *p)
+{
+    matvec_args *x = (matvec_args*)p;
+    matrix_vector_product_simd(x->a, x->b, x->c, x->m, x->n);
+}
+
+void run_bench(size_t n, size_t m)
+{
+    double *a, *b, *c;
+
+    a = (double*)malloc(sizeof(*a) * m * n);
+    b = (double*)malloc(sizeof(*b) * n);
+    c = (double*)malloc(sizeof(*c) * m);
+
+    if (a == NULL || b == NULL || c == NULL)
+    {
+        free(a);
+        free(b);
+        free(c);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < (int)m; i++)
+    {
+        for (int j = 0; j < (int)n; j++)
+            a[i * n + j] = i + j;
+        c[i] = 0.0;
+    }
+    for (int j = 0; j < (int)n; j++)
+        b[j] = j;
+
+    matvec_args args = {a, b, c, (int)m, (int)n};
+    double bytes = sizeof(double) * ((double)m * n + n + m);
+    double flops = 2.0 * m * n;
+    double peak = bench_stream_peak(1 << 25);
+    int threads = bench_threads();
+
+    bench_report("serial", m, n, 1, bench_run(bench_serial, &args, 1, 5), bytes, flops, peak, 0.0);
+    bench_report("omp", m, n, threads, bench_run(bench_omp, &args, 2, 10), bytes, flops, peak, 0.0);
+    bench_report("simd", m, n, threads, bench_run(bench_simd, &args, 2, 10), bytes, flops, peak, 0.0);
     free(a);
     free(b);
     free(c);
 }
 
+/*
+ * matrix_vector_product_ooc: c[m] = a[m][n] * b[n] with a streamed from a mapped
+ * matrix file. Threads take row panels in order; whoever takes panel p asks for
+ * readahead of panel p + depth, so the next panels are read while this one is
+ * multiplied, and releases p once it is done.
+ */
+void matrix_vector_product_ooc(const matfile *f, const double *b, double *c, int64_t panel_rows, int depth)
+{
+    const char *name;
+    matvec_kernel_t kernel = select_matvec_kernel(&name);
+    int64_t npanels = (f->m + panel_rows - 1) / panel_rows;
+    for (int64_t p = 0; p < depth && p < npanels; p++)
+        matfile_prefetch(f, p * panel_rows, (p + 1) * panel_rows < f->m ? (p + 1) * panel_rows : f->m);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t p = 0; p < npanels; p++)
+    {
+        int64_t lb = p * panel_rows;
+        int64_t ub = (lb + panel_rows < f->m) ? lb + panel_rows : f->m;
+        if (p + depth < npanels)
+        {
+            int64_t next = (p + depth) * panel_rows;
+            matfile_prefetch(f, next, (next + panel_rows < f->m) ? next + panel_rows : f->m);
+        }
+        kernel(f->a, b, c, (int)f->n, (int)lb, (int)ub);
+        matfile_release(f, lb, ub);
+    }
+}
+
+static void init_panel(double *rows, int64_t lb, int64_t ub, int64_t n, void *arg)
+{
+    (void)arg;
+    for (int64_t i = lb; i < ub; i++)
+        for (int64_t j = 0; j < n; j++)
+            rows[(i - lb) * n + j] = (double)(i + j);
+}
+
+/*
+ * write_matrix_file: store the matrix of run_parallel (a[i][j] = i + j) so the
+ * ooc mode can stream it; rows are generated 64 MB at a time.
+ */
+void write_matrix_file(size_t n, size_t m, const char *path)
+{
+    double t = cpuSecond();
+    if (matfile_write(path, m, n, (64 << 20) / (sizeof(double) * n) + 1, init_panel, NULL) != 0)
+    {
+        printf("Error writing %s!\n", path);
+        exit(1);
+    }
+    t = cpuSecond() - t;
+    printf("Wrote %zu x %zu matrix to %s: %.6f sec (%.2f MB/s).\n", m, n, path, t,
+           sizeof(double) * (double)m * n / t / 1048576.0);
+}
+
+void run_parallel_ooc(const char *path, size_t panel_mb, int depth)
+{
+    matfile f;
+    double *b, *c;
+    if (matfile_open(path, &f) != 0)
+    {
+        printf("Error opening %s!\n", path);
+        exit(1);
+    }
+    b = (double*)malloc(sizeof(*b) * f.n);
+    c = (double*)malloc(sizeof(*c) * f.m);
+    if (b == NULL || c == NULL)
+    {
+        free(b);
+        free(c);
+        matfile_close(&f);
+        printf("Error allocate memory!\n");
+        exit(1);
+    }
+    for (int64_t j = 0; j < f.n; j++)
+        b[j] = j;
+
+    int64_t panel_rows = matfile_panel_rows(&f, panel_mb << 20);
+    double t = cpuSecond();
+    matrix_vector_product_ooc(&f, b, c, panel_rows, depth);
+    t = cpuSecond() - t;
+
+    // c[i] = i * sum(j) + sum(j^2) для a[i][j] = i + j, b[j] = j
+    double n = (double)f.n, s1 = n * (n - 1) / 2, s2 = (n - 1) * n * (2 * n - 1) / 6, err = 0.0;
+    for (int64_t i = 0; i < f.m; i++)
+    {
+        double ref = i * s1 + s2, d = fabs(c[i] - ref) / (ref != 0.0 ? fabs(ref) : 1.0);
+        if (d > err)
+            err = d;
+    }
+    printf("Elapsed time (out-of-core, %lld x %lld, panels of %lld rows, depth %d): %.6f sec (%.2f MB/s).\n",
+           (long long)f.m, (long long)f.n, (long long)panel_rows, depth, t,
+           sizeof(double) * (double)f.m * f.n / t / 1048576.0);
+    printf("Max relative error: %.3e\n", err);
+    free(b);
+    free(c);
+    matfile_close(&f);
+}
+
 int main(int argc, char *argv[])
 {
     size_t M = 20000;
@@ -127,7 +1137,36 @@ int main(int argc, char *argv[])
         M = atoi(argv[1]);
     if (argc > 2)
         N = atoi(argv[2]);
+    const char *mode = (argc > 3) ? argv[3] : "omp";
+    if (strcmp(mode, "bench") == 0)
+    {
+        run_bench(M, N);
+        return 0;
+    }
+    if (strcmp(mode, "write") == 0)
+    {
+        write_matrix_file(M, N, (argc > 4) ? argv[4] : "matrix.bin");
+        return 0;
+    }
+    if (strcmp(mode, "ooc") == 0)
+    {
+        run_parallel_ooc((argc > 4) ? argv[4] : "matrix.bin", (argc > 5) ? atoi(argv[5]) : 16,
+                         (argc > 6) ? atoi(argv[6]) : 4);
+        return 0;
+    }
     run_serial(M, N);
     run_parallel(M, N);
+    if (strcmp(mode, "simd") == 0)
+        run_parallel_simd(M, N);
+    else if (strcmp(mode, "batch") == 0)
+        run_parallel_batch(M, N, (argc > 4) ? atoi(argv[4]) : 8);
+    else if (strcmp(mode, "float") == 0)
+        run_parallel_lowp(M, N, STORE_F32);
+    else if (strcmp(mode, "bf16") == 0)
+        run_parallel_lowp(M, N, STORE_BF16);
+    else if (strcmp(mode, "fp16") == 0)
+        run_parallel_lowp(M, N, STORE_F16);
+    else if (strcmp(mode, "csr") == 0)
+        run_parallel_sparse(M, N, (argc > 4) ? atof(argv[4]) : 0.01);
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
 #include <time.h>
+#include <string.h>
 #include <omp.h>
+#include <immintrin.h>
+
+#include "../../common/bench.h"
 
 const double PI = 3.14159265358979323846;
 const double a = -4.0;
@@ -54,6 +60,404 @@ double integrate_omp(double (*func)(double), double a, double b, int n)
     return sum;
 }
 
+/*
+ * exp_simd: branch-free exp for vectorized loops. x = k*ln2 + r with |r| <= ln2/2,
+ * exp(r) by a degree-12 Taylor polynomial, 2^k built directly in the exponent bits.
+ * Relative error is a few ulp for x in [-708, 709].
+ */
+static inline double exp_simd(double x)
+{
+    const double shifter = 6755399441055744.0; /* 1.5 * 2^52 */
+    x = x < -708.0 ? -708.0 : (x > 709.0 ? 709.0 : x);
+    double t = x * 1.4426950408889634 + shifter;
+    double k = t - shifter;
+    double r = x - k * 6.93147180369123816490e-01;
+    r = r - k * 1.90821492927058770002e-10;
+
+    double p = 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    uint64_t bits;
+    memcpy(&bits, &t, sizeof(bits));
+    bits = (bits + 1023) << 52;
+    double scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+/*
+ * exp_avx2: exp_simd on four lanes.
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256d exp_avx2(__m256d x)
+{
+    const __m256d shifter = _mm256_set1_pd(6755399441055744.0);
+    x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(709.0)), _mm256_set1_pd(-708.0));
+    __m256d t = _mm256_fmadd_pd(x, _mm256_set1_pd(1.4426950408889634), shifter);
+    __m256d k = _mm256_sub_pd(t, shifter);
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.93147180369123816490e-01), x);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.90821492927058770002e-10), r);
+
+    static const double coef[] = {1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+                                  1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0,
+                                  1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0};
+    __m256d p = _mm256_set1_pd(coef[0]);
+    for (int i = 1; i < 13; i++)
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(coef[i]));
+
+    __m256i bits = _mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023));
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52)));
+}
+
+/*
+ * gauss_integrand: exp(-x^2) as a functor, on one double and on four AVX2 lanes,
+ * so the integrators below get it inlined instead of called through a pointer.
+ */
+struct gauss_integrand
+{
+    double operator()(double x) const
+    {
+        return exp_simd(-x * x);
+    }
+
+    __attribute__((target("avx2,fma")))
+    __m256d operator()(__m256d x) const
+    {
+        return exp_avx2(_mm256_sub_pd(_mm256_setzero_pd(), _mm256_mul_pd(x, x)));
+    }
+};
+
+/*
+ * integrate_inline: parallel midpoint rule with the integrand expanded in the
+ * loop body. F must be callable on double; integrate_inline_avx2 also needs
+ * F(__m256d). The AVX2 loop is used when the CPU has it, the scalar one
+ * (vectorized by the compiler when built for a wider -march) otherwise.
+ * integrate/integrate_omp stay as the generic function-pointer path.
+ */
+template<typename F>
+static double integrate_inline_scalar(F f, double a, double b, int n)
+{
+    double h = (b - a) / n;
+    double sum = 0.0;
+    #pragma omp parallel for simd reduction(+:sum) schedule(static)
+    for (int i = 0; i < n; i++)
+        sum += f(a + h * (i + 0.5));
+    return sum * h;
+}
+
+template<typename F>
+__attribute__((target("avx2,fma")))
+static double integrate_inline_avx2(F f, double a, double b, int n)
+{
+    double h = (b - a) / n;
+    double sum = 0.0;
+    #pragma omp parallel reduction(+:sum)
+    {
+        int nthreads = omp_get_num_threads();
+        int threadid = omp_get_thread_num();
+        int items_per_thread = n / nthreads;
+        int lb = threadid * items_per_thread;
+        int ub = (threadid == nthreads - 1) ? n : (lb + items_per_thread);
+        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+        const __m256d va = _mm256_set1_pd(a), vh = _mm256_set1_pd(h);
+        const __m256d lane = _mm256_setr_pd(0.5, 1.5, 2.5, 3.5);
+        int i = lb;
+        for (; i + 7 < ub; i += 8)
+        {
+            __m256d k0 = _mm256_add_pd(_mm256_set1_pd((double)i), lane);
+            __m256d k1 = _mm256_add_pd(k0, _mm256_set1_pd(4.0));
+            s0 = _mm256_add_pd(s0, f(_mm256_fmadd_pd(vh, k0, va)));
+            s1 = _mm256_add_pd(s1, f(_mm256_fmadd_pd(vh, k1, va)));
+        }
+        double buf[4];
+        _mm256_storeu_pd(buf, _mm256_add_pd(s0, s1));
+        double sumloc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+        for (; i < ub; i++)
+            sumloc += f(a + h * (i + 0.5));
+        sum += sumloc;
+    }
+    return sum * h;
+}
+
+template<typename F>
+double integrate_inline(F f, double a, double b, int n)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return integrate_inline_avx2(f, a, b, n);
+    return integrate_inline_scalar(f, a, b, n);
+}
+
+double integrate_omp_func_simd(double a, double b, int n)
+{
+    return integrate_inline(gauss_integrand(), a, b, n);
+}
+
+/*
+ * Gauss-Kronrod 7-15 rule: abscissae and weights on [-1, 1] (QUADPACK qk15).
+ * Odd entries of xgk are the Gauss nodes, weighted by wg.
+ */
+static const double xgk[8] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.000000000000000000000000000000000};
+static const double wgk[8] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+static const double wg[4] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+/*
+ * gk15: 15-point Kronrod estimate of the integral over [a, b]; *err gets
+ * |K15 - G7| as the error estimate.
+ */
+double gk15(double (*func)(double), double a, double b, double *err)
+{
+    double center = 0.5 * (a + b);
+    double half = 0.5 * (b - a);
+    double fc = func(center);
+    double resk = fc * wgk[7];
+    double resg = fc * wg[3];
+    for (int j = 0; j < 7; j++)
+    {
+        double dx = half * xgk[j];
+        double fsum = func(center - dx) + func(center + dx);
+        resk += wgk[j] * fsum;
+        if (j % 2)
+            resg += wg[j / 2] * fsum;
+    }
+    *err = fabs((resk - resg) * half);
+    return resk * half;
+}
+
+/*
+ * integrate_adaptive_task: accept gk15 on [a, b] if its error estimate is within
+ * tol, otherwise bisect and refine both halves as OpenMP tasks with tol / 2 each.
+ * Subintervals deeper than max_depth are accepted as they are.
+ */
+static double integrate_adaptive_task(double (*func)(double), double a, double b, double tol,
+                                      int depth, long long *evals)
+{
+    double err;
+    double res = gk15(func, a, b, &err);
+    long long local_evals = 15;
+    const int max_depth = 50;
+    if (err > tol && depth < max_depth)
+    {
+        double mid = 0.5 * (a + b);
+        double left = 0.0, right = 0.0;
+        long long evals_left = 0, evals_right = 0;
+        #pragma omp task shared(left, evals_left) final(depth > 20)
+        left = integrate_adaptive_task(func, a, mid, 0.5 * tol, depth + 1, &evals_left);
+        right = integrate_adaptive_task(func, mid, b, 0.5 * tol, depth + 1, &evals_right);
+        #pragma omp taskwait
+        res = left + right;
+        local_evals += evals_left + evals_right;
+    }
+    *evals = local_evals;
+    return res;
+}
+
+/*
+ * integrate_adaptive: adaptive Gauss-Kronrod integration of func over [a, b] to an
+ * absolute tolerance tol. The interval is first cut into one piece per thread so
+ * every core starts with work; refinement then spreads as tasks. *evals gets the
+ * number of integrand evaluations.
+ */
+double integrate_adaptive(double (*func)(double), double a, double b, double tol, long long *evals)
+{
+    double sum = 0.0;
+    long long total = 0;
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            int pieces = omp_get_num_threads();
+            double h = (b - a) / pieces;
+            for (int p = 0; p < pieces; p++)
+            {
+                #pragma omp task shared(sum, total)
+                {
+                    long long e;
+                    double r = integrate_adaptive_task(func, a + h * p, (p == pieces - 1) ? b : a + h * (p + 1),
+                                                       tol / pieces, 0, &e);
+                    #pragma omp atomic
+                    sum += r;
+                    #pragma omp atomic
+                    total += e;
+                }
+            }
+        }
+    }
+    *evals = total;
+    return sum;
+}
+
+/*
+ * Randomized quasi-Monte Carlo over the cube [a, b]^dim. Points come from a
+ * Halton sequence with per-dimension digit scrambling plus a random shift;
+ * QMC_REPLICAS independent randomizations give the error estimate. The index
+ * range is cut into fixed blocks, each thread takes whole blocks (the Halton
+ * point of any index is computed directly, so blocks are independent streams)
+ * and block sums are added in block order, so the result does not depend on
+ * the number of threads.
+ */
+#define QMC_MAX_DIM 16
+#define QMC_REPLICAS 8
+#define QMC_BLOCK 4096
+
+static const int qmc_primes[QMC_MAX_DIM] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+
+typedef struct
+{
+    int dim;
+    unsigned char perm[QMC_REPLICAS][QMC_MAX_DIM][64];
+    double shift[QMC_REPLICAS][QMC_MAX_DIM];
+} qmc_scramble;
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void qmc_scramble_init(qmc_scramble *s, int dim, uint64_t seed)
+{
+    s->dim = dim;
+    for (int r = 0; r < QMC_REPLICAS; r++)
+    {
+        for (int d = 0; d < dim; d++)
+        {
+            int base = qmc_primes[d];
+            unsigned char *perm = s->perm[r][d];
+            /* digit 0 stays 0 so the trailing zeros of an index add nothing */
+            for (int k = 0; k < base; k++)
+                perm[k] = (unsigned char)k;
+            for (int k = base - 1; k > 1; k--)
+            {
+                int j = 1 + (int)(splitmix64(&seed) % (uint64_t)k);
+                unsigned char tmp = perm[k];
+                perm[k] = perm[j];
+                perm[j] = tmp;
+            }
+            s->shift[r][d] = (double)(splitmix64(&seed) >> 11) * (1.0 / 9007199254740992.0);
+        }
+    }
+}
+
+static double halton_scrambled(uint64_t i, int base, const unsigned char *perm)
+{
+    double inv = 1.0 / base, f = inv, r = 0.0;
+    while (i)
+    {
+        r += perm[i % base] * f;
+        i /= base;
+        f *= inv;
+    }
+    return r;
+}
+
+/*
+ * qmc_block: sums of f(x) over points [first, first + QMC_BLOCK) for every
+ * replica.
+ */
+static void qmc_block(double (*f)(const double *x, int dim), double a, double b, const qmc_scramble *s,
+                      uint64_t first, double *sums)
+{
+    double x[QMC_MAX_DIM];
+    for (int r = 0; r < QMC_REPLICAS; r++)
+    {
+        double sum = 0.0;
+        for (uint64_t i = first; i < first + QMC_BLOCK; i++)
+        {
+            for (int d = 0; d < s->dim; d++)
+            {
+                double u = halton_scrambled(i, qmc_primes[d], s->perm[r][d]) + s->shift[r][d];
+                if (u >= 1.0)
+                    u -= 1.0;
+                x[d] = a + (b - a) * u;
+            }
+            sum += f(x, s->dim);
+        }
+        sums[r] = sum;
+    }
+}
+
+/*
+ * integrate_qmc: integral of f(x) over [a, b]^dim. Points are added
+ * in doubling batches until the standard error over the replicas is below
+ * rel_tol * |estimate| or max_points per replica are used. nthreads = 0 uses
+ * the OpenMP default. *stderr_out and *points_out get the final error estimate
+ * and the total number of points (all replicas). Returns NAN on allocation failure.
+ */
+double integrate_qmc(double (*f)(const double *x, int dim), double a, double b, int dim, double rel_tol,
+                     long long max_points, int nthreads, double *stderr_out, long long *points_out)
+{
+    qmc_scramble scr;
+    qmc_scramble_init(&scr, dim, 20240501);
+    double vol = pow(b - a, dim);
+    double total[QMC_REPLICAS] = {0.0};
+    long long done = 0, blocks = 0;
+    double estimate = 0.0, stderr_est = INFINITY;
+    if (nthreads <= 0)
+        nthreads = omp_get_max_threads();
+
+    /* the batch schedule must not depend on nthreads, or the stopping point would */
+    long long batch = 16;
+    while (done < max_points)
+    {
+        if (done + batch * QMC_BLOCK > max_points)
+            batch = (max_points - done + QMC_BLOCK - 1) / QMC_BLOCK;
+        double *sums = (double*)malloc(sizeof(*sums) * batch * QMC_REPLICAS);
+        if (sums == NULL)
+            return NAN;
+        #pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+        for (long long blk = 0; blk < batch; blk++)
+            qmc_block(f, a, b, &scr, 1 + (uint64_t)(blocks + blk) * QMC_BLOCK, sums + blk * QMC_REPLICAS);
+        for (long long blk = 0; blk < batch; blk++)
+            for (int r = 0; r < QMC_REPLICAS; r++)
+                total[r] += sums[blk * QMC_REPLICAS + r];
+        free(sums);
+        blocks += batch;
+        done = blocks * QMC_BLOCK;
+        batch *= 2;
+
+        double mean = 0.0, var = 0.0;
+        for (int r = 0; r < QMC_REPLICAS; r++)
+            mean += vol * total[r] / done;
+        mean /= QMC_REPLICAS;
+        for (int r = 0; r < QMC_REPLICAS; r++)
+        {
+            double d = vol * total[r] / done - mean;
+            var += d * d;
+        }
+        estimate = mean;
+        stderr_est = sqrt(var / (QMC_REPLICAS - 1) / QMC_REPLICAS);
+        if (stderr_est <= rel_tol * fabs(estimate))
+            break;
+    }
+    *stderr_out = stderr_est;
+    *points_out = done * QMC_REPLICAS;
+    return estimate;
+}
+
 double run_serial()
 {
     double t = cpuSecond();
@@ -72,13 +476,145 @@ double run_parallel()
     return t;
 }
 
+double run_parallel_inline()
+{
+    double t = cpuSecond();
+    double res = integrate_omp_func_simd(a, b, nsteps);
+    t = cpuSecond() - t;
+    printf("Result (parallel inline): %.12f; error %.12f\n", res, fabs(res - sqrt(PI)));
+    return t;
+}
+
+double run_parallel_adaptive(double tol, long long *evals)
+{
+    double t = cpuSecond();
+    double res = integrate_adaptive(func, a, b, tol, evals);
+    t = cpuSecond() - t;
+    printf("Result (parallel adaptive, tol %.1e): %.12f; error %.12f; evaluations %lld\n",
+           tol, res, fabs(res - sqrt(PI)), *evals);
+    /* sqrt(PI) is the integral over the whole line; this is the one over [a, b] */
+    printf("Error vs exact integral on [a, b]: %.3e\n", fabs(res - 0.5 * sqrt(PI) * (erf(b) - erf(a))));
+    return t;
+}
+
+/* the multidimensional test integrand exp(-|x|^2) cos(x_1 + ... + x_dim) */
+static double gauss_wave(const double *x, int dim)
+{
+    double r2 = 0.0, s = 0.0;
+    for (int k = 0; k < dim; k++)
+    {
+        r2 += x[k] * x[k];
+        s += x[k];
+    }
+    return exp(-r2) * cos(s);
+}
+
+static double gauss_cos(double x)
+{
+    return exp(-x * x) * cos(x);
+}
+
+/*
+ * run_qmc: gauss_wave over [a, b]^dim, integrated once on one thread and once
+ * on all of them, reported like run_serial/run_parallel. cos(sum x_k) is the
+ * real part of prod_k e^{i x_k}, and on the symmetric [a, b] the sine part of
+ * each factor integrates to zero, so the reference value is the 1D integral of
+ * exp(-x^2) cos(x) to the power dim.
+ */
+void run_qmc(int dim, double rel_tol)
+{
+    double err_est, exact = pow(integrate(gauss_cos, a, b, 1 << 20), dim);
+    long long points;
+    const long long max_points = 1ll << 22;
+
+    printf("Integration exp(-|x|^2) cos(sum x_k) on [%.3f, %.3f]^%d, rel tol %.1e\n", a, b, dim, rel_tol);
+    double tserial = cpuSecond();
+    double res = integrate_qmc(gauss_wave, a, b, dim, rel_tol, max_points, 1, &err_est, &points);
+    tserial = cpuSecond() - tserial;
+    printf("Result (serial qmc): %.12f; error %.3e; estimate %.3e; points %lld\n",
+           res, fabs(res - exact), err_est, points);
+
+    double tparallel = cpuSecond();
+    res = integrate_qmc(gauss_wave, a, b, dim, rel_tol, max_points, 0, &err_est, &points);
+    tparallel = cpuSecond() - tparallel;
+    printf("Result (parallel qmc): %.12f; error %.3e; estimate %.3e; points %lld\n",
+           res, fabs(res - exact), err_est, points);
+
+    printf("Execution time (serial): %.6f\n", tserial);
+    printf("Execution time (parallel): %.6f\n", tparallel);
+    printf("Speedup: %.2f\n", tserial / tparallel);
+}
+
+static void bench_serial(void *res)
+{
+    *(double*)res = integrate(func, a, b, nsteps);
+}
+
+static void bench_omp(void *res)
+{
+    *(double*)res = integrate_omp(func, a, b, nsteps);
+}
+
+static void bench_inline(void *res)
+{
+    *(double*)res = integrate_omp_func_simd(a, b, nsteps);
+}
+
+/*
+ * run_bench: repeated runs of the integrators. The flop count is the 6
+ * arithmetic operations per step around the exp call.
+ */
+void run_bench()
+{
+    double res;
+    double flops = 6.0 * nsteps;
+    bench_stats serial = bench_run(bench_serial, &res, 1, 5);
+    bench_stats parallel = bench_run(bench_omp, &res, 1, 10);
+    bench_stats inlined = bench_run(bench_inline, &res, 1, 10);
+    bench_report("integrate", nsteps, 1, 1, serial, 0.0, flops, 0.0, 0.0);
+    bench_report("integrate_omp", nsteps, 1, bench_threads(), parallel, 0.0, flops, 0.0, 0.0);
+    bench_report("inline_simd", nsteps, 1, bench_threads(), inlined, 0.0, flops, 0.0, 0.0);
+    printf("Speedup (median): %.2f, inline vs pointer: %.2f\n",
+           serial.median / parallel.median, parallel.median / inlined.median);
+}
+
 int main(int argc, char **argv)
 {
     printf("Integration f(x) on [%.12f, %.12f], nsteps = %d\n", a, b, nsteps);
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    {
+        run_bench();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "qmc") == 0)
+    {
+        int dim = (argc > 2) ? atoi(argv[2]) : 4;
+        if (dim < 1 || dim > QMC_MAX_DIM)
+        {
+            printf("Dimension must be in [1, %d]\n", QMC_MAX_DIM);
+            return 1;
+        }
+        run_qmc(dim, (argc > 3) ? atof(argv[3]) : 1e-3);
+        return 0;
+    }
     double tserial = run_serial();
     double tparallel = run_parallel();
     printf("Execution time (serial): %.6f\n", tserial);
     printf("Execution time (parallel): %.6f\n", tparallel);
     printf("Speedup: %.2f\n", tserial / tparallel);
+    if (argc > 1 && strcmp(argv[1], "inline") == 0)
+    {
+        double tinline = run_parallel_inline();
+        printf("Execution time (parallel inline): %.6f\n", tinline);
+        printf("Speedup inline vs pointer: %.2f\n", tparallel / tinline);
+    }
+    if (argc > 1 && strcmp(argv[1], "adaptive") == 0)
+    {
+        long long evals;
+        double tadaptive = run_parallel_adaptive((argc > 2) ? atof(argv[2]) : 1e-10, &evals);
+        printf("Execution time (parallel adaptive): %.6f\n", tadaptive);
+        printf("Evaluations: %lld vs %d (%.0fx fewer), speedup vs parallel: %.2f\n",
+               evals, nsteps, (double)nsteps / evals, tparallel / tadaptive);
+    }
     return 0;
 }
\ No newline at end of file
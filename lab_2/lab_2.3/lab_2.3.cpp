@@ -1,15 +1,33 @@
 #include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../../common/alloc.h"
 
 using namespace std;
-double result_time1[81];
-double result_speed1[81];
-double result_time2[81];
-double result_speed2[81];
+// [номер решателя][число потоков]
+double result_time[8][81];
+double result_speed[8][81];
+int result_iter[8][81];
 
 int number_threads = 0;
+int check_interval = 1;
+int iterations = 0;
+// внешние шаги (double-проходы) последнего запуска смешанной точности
+int refinement_steps = 0;
 
 double completion_criteria1(double* a, double* b, double* x, int n) {
     double sum = 0.0, sum_b = 0.0;
@@ -49,7 +67,9 @@ double completion_criteria2(double* a, double* b, double* x, int n) {
 
 void solving_system_linear_equations_1(double* a, double* b, double* x, int n) {
     double* x_current = (double*)malloc(sizeof(double) * n);
+    iterations = 0;
     while(completion_criteria1(a, b, x, n) > 0.00001){
+        iterations++;
         #pragma omp parallel for num_threads(number_threads)
             for(int i = 0; i < n; i++) {
                 double current = 0;
@@ -62,13 +82,17 @@ void solving_system_linear_equations_1(double* a, double* b, double* x, int n) {
             for(int i = 0; i < n; i++)
                 x[i] -= x_current[i];
     }
+    free(x_current);
 }
 
 void solving_system_linear_equations_2(double* a, double* b, double* x, int n) {
         double* x_current = (double*)malloc(sizeof(double) * n);
+        iterations = 0;
         #pragma omp parallel num_threads(number_threads)
         {
             while(completion_criteria2(a, b, x, n) > 0.00001){
+                #pragma omp master
+                    iterations++;
                 #pragma omp for
                     for(int i = 0; i < n; i++) {
                         x_current[i] = 0;
@@ -82,73 +106,707 @@ void solving_system_linear_equations_2(double* a, double* b, double* x, int n) {
                         x[i] -= x_current[i];
             }
         }
+        free(x_current);
 }
 
-void run_parallel(size_t n, void (*func)(double*, double*, double*, int), int numb) {
-    double *a, *b, *x;
+// Оператор A для решателей: apply(x, y) считает y = A*x. apply вызывается всеми
+// потоками внутри parallel (в нём есть omp for с барьером на выходе) либо вне
+// parallel — тогда выполняется одним потоком.
+struct linear_operator {
+    int n;
+    explicit linear_operator(int n) : n(n) {}
+    virtual ~linear_operator() = default;
+    virtual void apply(const double* x, double* y) = 0;
+    virtual double diagonal(int i) const = 0;
+    // объём данных оператора, читаемых за одно применение
+    virtual size_t bytes() const = 0;
+};
 
-    a = (double*)malloc(sizeof(*a) * n * n);
-    b = (double*)malloc(sizeof(*b) * n);
-    x = (double*)malloc(sizeof(*x) * n);
+// плотная матрица a[n*n]
+struct dense_operator : linear_operator {
+    double* a;
+    dense_operator(double* a, int n) : linear_operator(n), a(a) {}
+    void apply(const double* x, double* y) override {
+        #pragma omp for
+            for(int i = 0; i < n; i++) {
+                double current = 0;
+                for(int j = 0; j < n; j++)
+                    current += a[(size_t)i * n + j] * x[j];
+                y[i] = current;
+            }
+    }
+    double diagonal(int i) const override { return a[(size_t)i * n + i]; }
+    size_t bytes() const override { return sizeof(double) * (size_t)n * n; }
+};
 
-    if(a == NULL || b == NULL || x == NULL) {
-        free(a);
-        free(b);
-        free(x);
+// диагональ плюс малый ранг: A = diag(d) + U * V^T, U и V — n x k по строкам;
+// O(n*k) памяти и работы на применение. Частичные суммы V^T x каждый поток
+// копит в своей строке scratch (stride кратен строке кэша), память под неё
+// выделяется один раз, при первом применении с данным числом потоков.
+struct low_rank_operator : linear_operator {
+    vector<double> d, u, v, s, scratch;
+    int k, stride;
+    low_rank_operator(vector<double> d, vector<double> u, vector<double> v, int k)
+        : linear_operator((int)d.size()), d(move(d)), u(move(u)), v(move(v)), s(k), k(k), stride((k + 7) / 8 * 8) {}
+    void apply(const double* x, double* y) override {
+        #pragma omp single
+        {
+            fill(s.begin(), s.end(), 0.0);
+            if(scratch.size() < (size_t)omp_get_num_threads() * stride)
+                scratch.resize((size_t)omp_get_num_threads() * stride);
+        }
+        double* local = scratch.data() + (size_t)omp_get_thread_num() * stride;
+        fill(local, local + k, 0.0);
+        #pragma omp for nowait
+            for(int i = 0; i < n; i++)
+                for(int c = 0; c < k; c++)
+                    local[c] += v[(size_t)i * k + c] * x[i];
+        #pragma omp critical
+            for(int c = 0; c < k; c++)
+                s[c] += local[c];
+        #pragma omp barrier
+        #pragma omp for
+            for(int i = 0; i < n; i++) {
+                double current = d[i] * x[i];
+                for(int c = 0; c < k; c++)
+                    current += u[(size_t)i * k + c] * s[c];
+                y[i] = current;
+            }
+    }
+    double diagonal(int i) const override {
+        double current = d[i];
+        for(int c = 0; c < k; c++)
+            current += u[(size_t)i * k + c] * v[(size_t)i * k + c];
+        return current;
+    }
+    size_t bytes() const override { return sizeof(double) * ((size_t)n * (2 * k + 1)); }
+};
+
+// оператор без матрицы: prepare(x) вызывается одним потоком перед применением
+// (например, для глобальных сумм), rows(x, y, lb, ub) — каждым потоком для своих строк
+struct matrix_free_operator : linear_operator {
+    function<void(const double*)> prepare;
+    function<void(const double*, double*, int, int)> rows;
+    function<double(int)> diag;
+    matrix_free_operator(int n, function<void(const double*)> prepare,
+                         function<void(const double*, double*, int, int)> rows, function<double(int)> diag)
+        : linear_operator(n), prepare(move(prepare)), rows(move(rows)), diag(move(diag)) {}
+    void apply(const double* x, double* y) override {
+        if(prepare) {
+            #pragma omp single
+                prepare(x);
+        }
+        int nthreads = omp_get_num_threads();
+        int threadid = omp_get_thread_num();
+        int items_per_thread = n / nthreads;
+        int lb = threadid * items_per_thread;
+        int ub = (threadid == nthreads - 1) ? n : (lb + items_per_thread);
+        rows(x, y, lb, ub);
+        #pragma omp barrier
+    }
+    double diagonal(int i) const override { return diag(i); }
+    size_t bytes() const override { return 0; }
+};
+
+// один проход по матрице за итерацию: r = A*x - b считается один раз и идёт
+// и в норму невязки (reduction), и в обновление x_next = x - 0.0001*r;
+// норма проверяется раз в check_interval итераций
+void solving_system_linear_equations_3(linear_operator& A, double* b, double* x, int n) {
+    double* x_next = (double*)malloc(sizeof(double) * n);
+    double* r = (double*)malloc(sizeof(double) * n);
+    double* x_cur = x;
+    double sum_b = 0.0, sum = 0.0;
+    bool done = false;
+    iterations = 0;
+    #pragma omp parallel num_threads(number_threads)
+    {
+        #pragma omp for reduction(+:sum_b)
+            for(int i = 0; i < n; i++)
+                sum_b += b[i] * b[i];
+        for(int iter = 0; !done; iter++) {
+            bool check = iter % check_interval == 0;
+            #pragma omp single
+                sum = 0.0;
+            A.apply(x_cur, r);
+            #pragma omp for reduction(+:sum)
+                for(int i = 0; i < n; i++) {
+                    double current = r[i] - b[i];
+                    if(check)
+                        sum += current * current;
+                    x_next[i] = x_cur[i] - 0.0001 * current;
+                }
+            #pragma omp single
+            {
+                if(check && sqrt(sum) / sqrt(sum_b) <= 0.00001)
+                    done = true;
+                else {
+                    swap(x_cur, x_next);
+                    iterations++;
+                }
+            }
+        }
+    }
+    if(x_cur != x)
+        copy(x_cur, x_cur + n, x);
+    free(x_cur == x ? x_next : x_cur);
+    free(r);
+}
+
+// метод сопряжённых градиентов (A симметричная положительно определённая),
+// с предобусловливателем Якоби z = r / diag(A) при jacobi = true
+void conjugate_gradient(linear_operator& A, double* b, double* x, int n, bool jacobi) {
+    double* r = (double*)malloc(sizeof(double) * n);
+    double* z = (double*)malloc(sizeof(double) * n);
+    double* p = (double*)malloc(sizeof(double) * n);
+    double* q = (double*)malloc(sizeof(double) * n);
+    double* dinv = (double*)malloc(sizeof(double) * n);
+    double sum_b = 0.0, rz = 0.0, rz_new = 0.0, pq = 0.0, rr = 0.0;
+    iterations = 0;
+    #pragma omp parallel num_threads(number_threads)
+    {
+        A.apply(x, q);
+        #pragma omp for reduction(+:sum_b, rz, rr)
+            for(int i = 0; i < n; i++) {
+                dinv[i] = jacobi ? 1.0 / A.diagonal(i) : 1.0;
+                r[i] = b[i] - q[i];
+                z[i] = r[i] * dinv[i];
+                p[i] = z[i];
+                rz += r[i] * z[i];
+                rr += r[i] * r[i];
+                sum_b += b[i] * b[i];
+            }
+        // каждый поток сравнивает rr до того, как его обнулят на следующей итерации
+        bool converged = sqrt(rr) / sqrt(sum_b) <= 0.00001;
+        #pragma omp barrier
+        while(!converged) {
+            #pragma omp single
+            {
+                pq = 0.0;
+                rr = 0.0;
+                rz_new = 0.0;
+            }
+            A.apply(p, q);
+            #pragma omp for reduction(+:pq)
+                for(int i = 0; i < n; i++)
+                    pq += p[i] * q[i];
+            double alpha = rz / pq;
+            #pragma omp for reduction(+:rr, rz_new)
+                for(int i = 0; i < n; i++) {
+                    x[i] += alpha * p[i];
+                    r[i] -= alpha * q[i];
+                    z[i] = r[i] * dinv[i];
+                    rr += r[i] * r[i];
+                    rz_new += r[i] * z[i];
+                }
+            converged = sqrt(rr) / sqrt(sum_b) <= 0.00001;
+            double beta = rz_new / rz;
+            #pragma omp for
+                for(int i = 0; i < n; i++)
+                    p[i] = z[i] + beta * p[i];
+            #pragma omp single
+            {
+                rz = rz_new;
+                iterations++;
+            }
+        }
+    }
+    free(r);
+    free(z);
+    free(p);
+    free(q);
+    free(dinv);
+}
+
+void solving_system_linear_equations_cg(linear_operator& A, double* b, double* x, int n) {
+    conjugate_gradient(A, b, x, n, false);
+}
+
+void solving_system_linear_equations_pcg(linear_operator& A, double* b, double* x, int n) {
+    conjugate_gradient(A, b, x, n, true);
+}
+
+// Оценка границ спектра A степенным методом: lmax по A, lmin по sigma*I - A.
+// Отношение Рэлея даёт lmax снизу и lmin сверху, поэтому границы расширены на
+// 10%: недооценённый lmax ведёт Чебышёва к расходимости. Более узкие границы
+// (запас 1% плюс невязка ||A v - vw v||) на системе лабораторной не помогают:
+// 197 итераций вместо 223 при n = 2000, но 528 вместо 459 при n = 16000.
+void estimate_spectrum(linear_operator& A, int n, double* lmin, double* lmax) {
+    double* v = (double*)malloc(sizeof(double) * n);
+    double* w = (double*)malloc(sizeof(double) * n);
+    double norm = 0.0, vw = 0.0, shift = 0.0;
+    const int steps = 30;
+    #pragma omp parallel num_threads(number_threads)
+    {
+        for(int pass = 0; pass < 2; pass++) {
+            #pragma omp for
+                for(int i = 0; i < n; i++)
+                    v[i] = 1.0 + 0.5 * sin(i + 1.0);
+            for(int k = 0; k < steps; k++) {
+                #pragma omp single
+                {
+                    norm = 0.0;
+                    vw = 0.0;
+                }
+                A.apply(v, w);
+                #pragma omp for reduction(+:norm, vw)
+                    for(int i = 0; i < n; i++) {
+                        if(pass == 1)
+                            w[i] = shift * v[i] - w[i];
+                        norm += w[i] * w[i];
+                        vw += v[i] * w[i];
+                    }
+                double inv = 1.0 / sqrt(norm);
+                #pragma omp for
+                    for(int i = 0; i < n; i++)
+                        v[i] = w[i] * inv;
+            }
+            // vw — отношение Рэлея: на последнем шаге v уже нормирован
+            #pragma omp single
+            {
+                if(pass == 0) {
+                    *lmax = 1.1 * vw;
+                    shift = *lmax;
+                }
+                else
+                    *lmin = 0.9 * (shift - vw);
+            }
+        }
+    }
+    free(v);
+    free(w);
+}
+
+// Ускоренный по Чебышёву метод Ричардсона на отрезке спектра [lmin, lmax].
+// Число итераций ~ sqrt(lmax / lmin) * ln(2 / eps) / 2 при любой правой части.
+// На системе лабораторной (2 на диагонали, 1 вне её) спектр {1, n + 1}, а b и
+// x0 = 0 дают невязку строго вдоль собственного вектора n + 1, так что простой
+// Ричардсон сходится за десятки шагов, а Чебышёв, рассчитанный на худшую
+// правую часть, делает в разы больше (n = 2000: 223 итерации против 52,
+// n = 16000: 459 против 23, по времени примерно в 5 раз дольше). Выигрывает он,
+// когда невязка затрагивает весь спектр.
+void solving_system_linear_equations_cheb(linear_operator& A, double* b, double* x, int n) {
+    double lmin, lmax;
+    estimate_spectrum(A, n, &lmin, &lmax);
+    if(lmin <= 0)
+        lmin = lmax * 1e-6;
+    double* r = (double*)malloc(sizeof(double) * n);
+    double* d = (double*)malloc(sizeof(double) * n);
+    double* q = (double*)malloc(sizeof(double) * n);
+    const double theta = 0.5 * (lmax + lmin), delta = 0.5 * (lmax - lmin);
+    const double sigma = theta / delta;
+    const int max_iterations = 100000;
+    double rho = 1.0 / sigma, sum_b = 0.0, rr = 0.0;
+    iterations = 0;
+    #pragma omp parallel num_threads(number_threads)
+    {
+        A.apply(x, q);
+        #pragma omp for reduction(+:sum_b, rr)
+            for(int i = 0; i < n; i++) {
+                r[i] = b[i] - q[i];
+                d[i] = r[i] / theta;
+                rr += r[i] * r[i];
+                sum_b += b[i] * b[i];
+            }
+        while(sqrt(rr) / sqrt(sum_b) > 0.00001 && iterations < max_iterations) {
+            #pragma omp for
+                for(int i = 0; i < n; i++)
+                    x[i] += d[i];
+            #pragma omp single
+                rr = 0.0;
+            A.apply(d, q);
+            #pragma omp for reduction(+:rr)
+                for(int i = 0; i < n; i++) {
+                    r[i] -= q[i];
+                    rr += r[i] * r[i];
+                }
+            double rho_new = 1.0 / (2.0 * sigma - rho);
+            #pragma omp for
+                for(int i = 0; i < n; i++)
+                    d[i] = rho_new * rho * d[i] + 2.0 * rho_new / delta * r[i];
+            #pragma omp single
+            {
+                rho = rho_new;
+                iterations++;
+            }
+        }
+    }
+    free(r);
+    free(d);
+    free(q);
+}
+
+// смешанная точность: внутренние итерации Ричардсона для A*d = r идут по float-копии
+// матрицы (вдвое меньше трафика), невязка r = b - A*x и поправка x += d — в double
+void solving_system_linear_equations_mp(double* a, double* b, double* x, int n) {
+    float* af = (float*)malloc(sizeof(float) * n * n);
+    double* r = (double*)malloc(sizeof(double) * n);
+    double* d = (double*)malloc(sizeof(double) * n);
+    double* d_next = (double*)malloc(sizeof(double) * n);
+    if(af == NULL || r == NULL || d == NULL || d_next == NULL) {
+        free(af);
+        free(r);
+        free(d);
+        free(d_next);
         cout << "Error allocate memory!" << endl;
         exit(1);
     }
+    double sum_b = 0.0, rr = 0.0, ss = 0.0;
+    const double inner_tol = 0.0001;
+    const int inner_max = 10000;
+    int outer = 0;
+    iterations = 0;
+    #pragma omp parallel num_threads(number_threads)
+    {
+        #pragma omp for reduction(+:sum_b)
+            for(int i = 0; i < n; i++) {
+                for(int j = 0; j < n; j++)
+                    af[(size_t)i * n + j] = (float)a[(size_t)i * n + j];
+                sum_b += b[i] * b[i];
+            }
+        while(true) {
+            #pragma omp single
+                rr = 0.0;
+            #pragma omp for reduction(+:rr)
+                for(int i = 0; i < n; i++) {
+                    double current = b[i];
+                    for(int j = 0; j < n; j++)
+                        current -= a[(size_t)i * n + j] * x[j];
+                    r[i] = current;
+                    rr += current * current;
+                    d[i] = 0.0;
+                }
+            double rnorm = sqrt(rr);
+            bool converged = rnorm / sqrt(sum_b) <= 0.00001;
+            #pragma omp barrier
+            if(converged)
+                break;
+
+            double* d_cur = d;
+            double* d_new = d_next;
+            for(int k = 0; k < inner_max; k++) {
+                #pragma omp single
+                    ss = 0.0;
+                #pragma omp for reduction(+:ss)
+                    for(int i = 0; i < n; i++) {
+                        const float* row = af + (size_t)i * n;
+                        double current = 0;
+                        for(int j = 0; j < n; j++)
+                            current += row[j] * d_cur[j];
+                        current = r[i] - current;
+                        ss += current * current;
+                        d_new[i] = d_cur[i] + 0.0001 * current;
+                    }
+                // остаток внутренней задачи станет новой невязкой: хватит либо inner_tol,
+                // либо половины целевой невязки 1e-5*|b|
+                bool inner_done = sqrt(ss) <= max(inner_tol * rnorm, 0.5 * 0.00001 * sqrt(sum_b));
+                #pragma omp barrier
+                swap(d_cur, d_new);
+                #pragma omp master
+                    iterations++;
+                if(inner_done)
+                    break;
+            }
+            #pragma omp for
+                for(int i = 0; i < n; i++)
+                    x[i] += d_cur[i];
+            #pragma omp master
+                outer++;
+        }
+    }
+    refinement_steps = outer + 1;
+    free(af);
+    free(r);
+    free(d);
+    free(d_next);
+}
+
+// решатель работает либо с сырой плотной матрицей (dense), либо с оператором (op)
+struct solver {
+    string key;
+    string title;
+    void (*dense)(double*, double*, double*, int);
+    void (*op)(linear_operator&, double*, double*, int);
+};
 
+// вид оператора тестовой матрицы (2 на диагонали, 1 вне её): dense, lowrank, matfree
+string operator_kind = "dense";
+
+bool needs_dense(const solver& s) {
+    return operator_kind == "dense" || s.op == nullptr;
+}
+
+// a может быть NULL, если плотная матрица не нужна
+void init_system(double* a, double* b, double* x, size_t n) {
     #pragma omp parallel for num_threads(number_threads)
-        for(int i = 0; i < n; i++){
-            for(int j = 0; j < n; j++)
-                a[i * n + j] = (i == j) ? 2 : 1;
+        for(int i = 0; i < (int)n; i++){
+            if(a != NULL)
+                for(int j = 0; j < (int)n; j++)
+                    a[i * n + j] = (i == j) ? 2 : 1;
             b[i] = n + 1;
             x[i] = 0.0;
         }
+}
+
+// решает систему и возвращает время; op_bytes — объём данных оператора
+double solve_timed(double* a, double* b, double* x, size_t n, const solver& s, size_t* op_bytes) {
+    unique_ptr<linear_operator> A;
+    double sum_x = 0.0;
+    // A = I + ones * ones^T
+    if(operator_kind == "lowrank")
+        A = make_unique<low_rank_operator>(vector<double>(n, 1.0), vector<double>(n, 1.0), vector<double>(n, 1.0), 1);
+    else if(operator_kind == "matfree")
+        A = make_unique<matrix_free_operator>(n,
+            [&sum_x, n](const double* v) { sum_x = 0.0; for(size_t i = 0; i < n; i++) sum_x += v[i]; },
+            [&sum_x](const double* v, double* y, int lb, int ub) { for(int i = lb; i < ub; i++) y[i] = v[i] + sum_x; },
+            [](int) { return 2.0; });
+    else
+        A = make_unique<dense_operator>(a, n);
 
     const auto start{chrono::steady_clock::now()};
-    func(a, b, x, n);
+    if(s.op != nullptr)
+        s.op(*A, b, x, n);
+    else
+        s.dense(a, b, x, n);
     const auto end{chrono::steady_clock::now()};
     const chrono::duration<double> elapsed_seconds{end - start};
+    if(op_bytes != nullptr)
+        *op_bytes = A->bytes();
+    return elapsed_seconds.count();
+}
+
+void run_parallel(size_t n, const solver& s, int numb) {
+    double *a = NULL, *b, *x;
+    size_t op_bytes = 0;
 
-    if(numb == 1){
-        result_time1[number_threads] = elapsed_seconds.count();
-        result_speed1[number_threads] =  result_time1[1] / result_time1[number_threads];
+    b = (double*)malloc(sizeof(*b) * n);
+    x = (double*)malloc(sizeof(*x) * n);
+    if(needs_dense(s))
+        a = (double*)kernel_alloc(sizeof(*a) * n * n);
+
+    if(b == NULL || x == NULL || (needs_dense(s) && a == NULL)) {
+        kernel_free(a);
+        free(b);
+        free(x);
+        cout << "Error allocate memory!" << endl;
+        exit(1);
     }
-    else{
-        result_time2[number_threads] = elapsed_seconds.count();
-        result_speed2[number_threads] =  result_time2[1] / result_time2[number_threads];
+
+    // init_system и решатели делят строки одинаково (static), поэтому страницы a
+    // попадают на узел того потока, который потом их читает
+    init_system(a, b, x, n);
+    int *tlb = kernel_alloc_stats() ? tlb_team_open(number_threads) : NULL;
+    double elapsed = solve_timed(a, b, x, n, s, &op_bytes);
+    long long misses = tlb_team_close(tlb, number_threads);
+
+    result_time[numb][number_threads] = elapsed;
+    result_speed[numb][number_threads] = result_time[numb][1] / result_time[numb][number_threads];
+    result_iter[numb][number_threads] = iterations;
+    cout << "Elapsed time:" << elapsed << "sec, iterations: " << iterations;
+    if(s.op != nullptr)
+        cout << ", operator " << operator_kind << " " << op_bytes / 1048576.0 << " MB";
+    cout << endl;
+    if(s.dense == solving_system_linear_equations_mp)
+        cout << "Refinement steps (double sweeps): " << refinement_steps << ", inner float sweeps: " << iterations << endl;
+    if(kernel_alloc_stats() && a != NULL) {
+        huge_report("a", a, sizeof(*a) * n * n);
+        cout << "dTLB load misses: " << misses << endl;
     }
-    cout << "Elapsed time:" << elapsed_seconds.count() << "sec" << endl;
-    
-    free(a);
+
+    kernel_free(a);
     free(b);
     free(x);
 }
 
+int read_sysfs_int(const string& path, int def) {
+    ifstream in(path);
+    int v;
+    return (in >> v) ? v : def;
+}
+
+// Порядок логических CPU для привязки потоков:
+// compact — ядра сокета подряд, гиперпотоки ядра рядом;
+// scatter — сначала по одному потоку на физическое ядро, сокеты чередуются;
+// numa    — узлы NUMA чередуются.
+vector<int> affinity_order(const string& policy) {
+    struct cpu_info { int cpu, package, core, node, smt, core_rank, node_rank; };
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    vector<cpu_info> cpus;
+    for(int c = 0; c < CPU_SETSIZE; c++) {
+        if(!CPU_ISSET(c, &allowed))
+            continue;
+        string base = "/sys/devices/system/cpu/cpu" + to_string(c);
+        int node = 0;
+        for(int k = 0; k < 64; k++)
+            if(ifstream(base + "/node" + to_string(k) + "/cpulist")) {
+                node = k;
+                break;
+            }
+        cpus.push_back({c, read_sysfs_int(base + "/topology/physical_package_id", 0),
+                        read_sysfs_int(base + "/topology/core_id", c), node, 0, 0, 0});
+    }
+    sort(cpus.begin(), cpus.end(), [](const cpu_info& l, const cpu_info& r) {
+        return make_tuple(l.package, l.core, l.cpu) < make_tuple(r.package, r.core, r.cpu);
+    });
+    // номер гиперпотока в ядре, номер ядра в сокете, номер CPU в узле
+    map<pair<int, int>, int> smt_count;
+    map<int, set<int>> package_cores;
+    map<int, int> node_count;
+    for(cpu_info& c : cpus) {
+        c.smt = smt_count[{c.package, c.core}]++;
+        package_cores[c.package].insert(c.core);
+        c.core_rank = (int)package_cores[c.package].size() - 1;
+        c.node_rank = node_count[c.node]++;
+    }
+    if(policy == "scatter")
+        sort(cpus.begin(), cpus.end(), [](const cpu_info& l, const cpu_info& r) {
+            return make_tuple(l.smt, l.core_rank, l.package) < make_tuple(r.smt, r.core_rank, r.package);
+        });
+    else if(policy == "numa")
+        sort(cpus.begin(), cpus.end(), [](const cpu_info& l, const cpu_info& r) {
+            return make_tuple(l.node_rank, l.node) < make_tuple(r.node_rank, r.node);
+        });
+    vector<int> order;
+    for(const cpu_info& c : cpus)
+        order.push_back(c.cpu);
+    return order;
+}
+
+// Привязывает потоки команды из number_threads потоков к CPU из order.
+// libgomp переиспользует одни и те же потоки в следующих parallel, поэтому
+// привязка сохраняется до смены числа потоков.
+void pin_threads(const vector<int>& order) {
+    if(order.empty())
+        return;
+    #pragma omp parallel num_threads(number_threads)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(order[omp_get_thread_num() % order.size()], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+}
+
+// Исследование масштабируемости. Для каждого числа потоков t система
+// выделяется заново и заполняется (первое касание) теми же t потоками с той же
+// привязкой, что и при счёте, поэтому страницы a лежат у узлов этих потоков;
+// между решателями сбрасывается только x. При weak-масштабировании на t потоках
+// решается система размера n * sqrt(t), чтобы работа на поток за итерацию
+// (~n^2 / t) не менялась; число итераций при этом зависит от размера, поэтому
+// эффективность считается по времени одной итерации.
+void run_sweep(size_t n, int max_threads, const vector<solver>& solvers, const vector<int>& active,
+               const string& scaling, const string& affinity, const string& csv_path) {
+    const bool weak = scaling == "weak";
+    bool dense = false;
+    for (int s : active)
+        dense = dense || needs_dense(solvers[s]);
+
+    vector<int> order = affinity == "none" ? vector<int>() : affinity_order(affinity);
+
+    ofstream csv(csv_path);
+    csv << "solver,scaling,affinity,threads,n,time,iterations,time_per_iter,speedup,efficiency" << endl;
+    vector<double> base(solvers.size(), 0.0);
+    for (int t = 1; t <= max_threads; t++) {
+        number_threads = t;
+        pin_threads(order);
+        const size_t nt = weak ? (size_t)(n * sqrt((double)t) + 0.5) : n;
+        double *a = NULL, *b, *x;
+        b = (double*)malloc(sizeof(*b) * nt);
+        x = (double*)malloc(sizeof(*x) * nt);
+        if(dense)
+            a = (double*)kernel_alloc(sizeof(*a) * nt * nt);
+        if(b == NULL || x == NULL || (dense && a == NULL)) {
+            kernel_free(a);
+            free(b);
+            free(x);
+            cout << "Error allocate memory!" << endl;
+            exit(1);
+        }
+        init_system(a, b, x, nt);
+        for (int s : active) {
+            #pragma omp parallel for num_threads(number_threads)
+                for(int i = 0; i < (int)nt; i++)
+                    x[i] = 0.0;
+            double elapsed = solve_timed(a, b, x, nt, solvers[s], nullptr);
+            double per_iter = elapsed / max(iterations, 1);
+            double metric = weak ? per_iter : elapsed;
+            if(t == 1)
+                base[s] = metric;
+            double efficiency = weak ? base[s] / metric : base[s] / metric / t;
+            double speedup = weak ? efficiency * t : base[s] / metric;
+            cout << solvers[s].key << " " << t << " threads, n = " << nt << ": " << elapsed << " sec, "
+                 << iterations << " iterations, speedup " << speedup << ", efficiency " << efficiency << endl;
+            csv << solvers[s].key << "," << scaling << "," << affinity << "," << t << "," << nt << ","
+                << elapsed << "," << iterations << "," << per_iter << "," << speedup << "," << efficiency << endl;
+        }
+        kernel_free(a);
+        free(b);
+        free(x);
+    }
+}
+
 int main(int argc, char *argv[]) {
     int n = 16000;
-    for (int i = 1; i <= 80; i++){
+    int max_threads = 80;
+    string selected = "1,2,3,cg,pcg,cheb,mp";
+    vector<solver> solvers = {
+        {"1", "The first program is running!", solving_system_linear_equations_1, nullptr},
+        {"2", "The second program is running!", solving_system_linear_equations_2, nullptr},
+        {"3", "The third program (fused residual) is running!", nullptr, solving_system_linear_equations_3},
+        {"cg", "Conjugate gradient is running!", nullptr, solving_system_linear_equations_cg},
+        {"pcg", "Jacobi-preconditioned conjugate gradient is running!", nullptr, solving_system_linear_equations_pcg},
+        {"cheb", "Chebyshev-accelerated Richardson is running!", nullptr, solving_system_linear_equations_cheb},
+        {"mp", "Mixed-precision iterative refinement is running!", solving_system_linear_equations_mp, nullptr},
+    };
+    if (argc > 1)
+        n = atoi(argv[1]);
+    if (argc > 2)
+        max_threads = min(atoi(argv[2]), 80);
+    if (argc > 3)
+        check_interval = max(atoi(argv[3]), 1);
+    if (argc > 4)
+        selected = argv[4];
+    if (argc > 5)
+        operator_kind = argv[5];
+    // режим масштабирования: strong | weak [compact | scatter | numa | none] [файл.csv]
+    string scaling = (argc > 6) ? argv[6] : "";
+    string affinity = (argc > 7) ? argv[7] : "compact";
+    string csv_path = (argc > 8) ? argv[8] : "scaling.csv";
+
+    vector<int> active;
+    stringstream keys(selected);
+    for (string key; getline(keys, key, ',');) {
+        for (int s = 0; s < (int)solvers.size(); s++)
+            if (solvers[s].key == key)
+                active.push_back(s);
+    }
+
+    if (scaling == "strong" || scaling == "weak") {
+        run_sweep(n, max_threads, solvers, active, scaling, affinity, csv_path);
+        return 0;
+    }
+
+    for (int i = 1; i <= max_threads; i++){
         number_threads = i;
         cout << i << " thread" << endl;
-        cout << "The first program is running!" << endl;
-        run_parallel(n, solving_system_linear_equations_1, 1);
-        cout << "The second program is running!"<< endl;
-        run_parallel(n, solving_system_linear_equations_2, 2);
+        for (int s : active) {
+            cout << solvers[s].title << endl;
+            run_parallel(n, solvers[s], s + 1);
+        }
+        cout << endl;
+    }
+    for (int s : active) {
+        cout << solvers[s].key << ":" << endl;
+        for(int i = 1; i <= max_threads; i++)
+            cout << result_time[s + 1][i] << " ";
+        cout << endl;
+        for(int i = 1; i <= max_threads; i++)
+            cout << result_speed[s + 1][i] << " ";
+        cout << endl;
+        for(int i = 1; i <= max_threads; i++)
+            cout << result_iter[s + 1][i] << " ";
         cout << endl;
     }
-    for(int i = 1; i <= 80; i++)
-        cout << result_time1[i] << " ";
-    cout << endl;
-    for(int i = 1; i <= 80; i++)
-        cout << result_speed1[i] << " ";
-    cout << endl;
-    for(int i = 1; i <= 80; i++)
-        cout << result_time2[i] << " ";
-    cout << endl;
-    for(int i = 1; i <= 80; i++)
-        cout << result_speed2[i] << " ";
-    cout << endl;
     return 0;
-}
\ No newline at end of file
+}
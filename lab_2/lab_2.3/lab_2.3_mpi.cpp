@@ -0,0 +1,167 @@
+#include <mpi.h>
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Распределённый вариант solving_system_linear_equations_2: матрица режется на
+// блоки строк по процессам MPI, внутри процесса строки считают потоки OpenMP.
+// После каждой итерации каждый процесс рассылает свой кусок x остальным; пока
+// куски идут, считается вклад своих столбцов, а чужие блоки столбцов
+// досчитываются по мере прихода соответствующих кусков.
+
+int number_threads = 1;
+
+struct row_block {
+    vector<int> first;   // first[r] — первая строка процесса r, first[size] = n
+    int rank, size;
+    int lb() const { return first[rank]; }
+    int ub() const { return first[rank + 1]; }
+    int rows() const { return ub() - lb(); }
+};
+
+row_block split_rows(int n, int rank, int size) {
+    row_block blocks{vector<int>(size + 1), rank, size};
+    for(int r = 0; r <= size; r++)
+        blocks.first[r] = (int)((long long)n * r / size);
+    return blocks;
+}
+
+// acc[i] += сумма a[i][j] * x[j] по столбцам [col_lb, col_ub) для своих строк
+void accumulate_columns(const double* a, const double* x, double* acc, int rows, int n, int col_lb, int col_ub) {
+    #pragma omp parallel for num_threads(number_threads)
+        for(int i = 0; i < rows; i++) {
+            double current = 0;
+            for(int j = col_lb; j < col_ub; j++)
+                current += a[(size_t)i * n + j] * x[j];
+            acc[i] += current;
+        }
+}
+
+// a — свои строки (rows x n), b — своя часть правой части, x — полный вектор на каждом процессе
+int solving_system_linear_equations_mpi(const double* a, const double* b, double* x, int n, const row_block& blocks) {
+    const int rows = blocks.rows(), lb = blocks.lb();
+    vector<double> acc(rows);
+    vector<MPI_Request> requests;
+    vector<int> source;
+    for(int r = 0; r < blocks.size; r++)
+        if(r != blocks.rank)
+            source.push_back(r);
+    double sum_b_local = 0.0, sum_b = 0.0;
+    for(int i = 0; i < rows; i++)
+        sum_b_local += b[i] * b[i];
+    MPI_Allreduce(&sum_b_local, &sum_b, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    int iterations = 0;
+    while(true) {
+        // обмен кусками x текущей итерации
+        requests.clear();
+        for(int r : source) {
+            MPI_Request req;
+            MPI_Irecv(x + blocks.first[r], blocks.first[r + 1] - blocks.first[r], MPI_DOUBLE, r, 0, MPI_COMM_WORLD, &req);
+            requests.push_back(req);
+        }
+        const int recv_count = (int)requests.size();
+        for(int r : source) {
+            MPI_Request req;
+            MPI_Isend(x + lb, rows, MPI_DOUBLE, r, 0, MPI_COMM_WORLD, &req);
+            requests.push_back(req);
+        }
+
+        // свой блок столбцов доступен сразу
+        fill(acc.begin(), acc.end(), 0.0);
+        accumulate_columns(a, x, acc.data(), rows, n, lb, blocks.ub());
+        for(int k = 0; k < recv_count; k++) {
+            int idx;
+            MPI_Waitany(recv_count, requests.data(), &idx, MPI_STATUS_IGNORE);
+            int r = source[idx];
+            accumulate_columns(a, x, acc.data(), rows, n, blocks.first[r], blocks.first[r + 1]);
+        }
+        MPI_Waitall((int)requests.size() - recv_count, requests.data() + recv_count, MPI_STATUSES_IGNORE);
+
+        double sum_local = 0.0, sum = 0.0;
+        #pragma omp parallel for num_threads(number_threads) reduction(+:sum_local)
+            for(int i = 0; i < rows; i++) {
+                acc[i] -= b[i];
+                sum_local += acc[i] * acc[i];
+            }
+        MPI_Allreduce(&sum_local, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        if(sqrt(sum) / sqrt(sum_b) <= 0.00001)
+            break;
+
+        #pragma omp parallel for num_threads(number_threads)
+            for(int i = 0; i < rows; i++)
+                x[lb + i] -= 0.0001 * acc[i];
+        iterations++;
+    }
+    return iterations;
+}
+
+int main(int argc, char *argv[]) {
+    // внутри ранга работают потоки OpenMP, MPI вызывается только из главного
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0)
+            cout << "MPI does not support MPI_THREAD_FUNNELED!" << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    int n = 16000;
+    if (argc > 1)
+        n = atoi(argv[1]);
+    number_threads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+
+    row_block blocks = split_rows(n, rank, size);
+    const int rows = blocks.rows();
+    double *a, *b, *x;
+    a = (double*)malloc(sizeof(*a) * rows * n + 1);
+    b = (double*)malloc(sizeof(*b) * rows + 1);
+    x = (double*)malloc(sizeof(*x) * n);
+
+    if(a == NULL || b == NULL || x == NULL) {
+        free(a);
+        free(b);
+        free(x);
+        cout << "Error allocate memory!" << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    #pragma omp parallel for num_threads(number_threads)
+        for(int i = 0; i < rows; i++){
+            for(int j = 0; j < n; j++)
+                a[(size_t)i * n + j] = (blocks.lb() + i == j) ? 2 : 1;
+            b[i] = n + 1;
+        }
+    for(int j = 0; j < n; j++)
+        x[j] = 0.0;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    int iterations = solving_system_linear_equations_mpi(a, b, x, n, blocks);
+    double elapsed = MPI_Wtime() - start, elapsed_max;
+    MPI_Reduce(&elapsed, &elapsed_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    // точное решение — вектор из единиц
+    double err_local = 0.0, err;
+    for(int i = blocks.lb(); i < blocks.ub(); i++)
+        err_local = max(err_local, fabs(x[i] - 1.0));
+    MPI_Reduce(&err_local, &err, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if(rank == 0) {
+        cout << "n = " << n << ", ranks: " << size << ", threads per rank: " << number_threads << endl;
+        cout << "Elapsed time:" << elapsed_max << "sec, iterations: " << iterations << endl;
+        cout << "Max |x - 1|: " << err << endl;
+    }
+    free(a);
+    free(b);
+    free(x);
+    MPI_Finalize();
+    return 0;
+}
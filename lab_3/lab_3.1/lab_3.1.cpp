@@ -3,6 +3,17 @@
 #include <chrono>
 #include <vector>
 #include <thread>
+#include <barrier>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+#include "../../common/bench.h"
+#include "../../common/sparse.h"
+#include "../../common/matfile.h"
+#include "../../common/alloc.h"
 
 using namespace std;
 
@@ -48,6 +59,183 @@ void matrix_vector_product_parallel(double *a, double *b, double *c, int m, int
     }
 }
 
+void matrix_vector_product_rows(const double *a, const double *b, double *c, int n, int lb, int ub)
+{
+    for (int i = lb; i < ub; i++)
+    {
+        double sum = 0.0;
+        for (int j = 0; j < n; j++)
+            sum += a[(size_t)i * n + j] * b[j];
+        c[i] = sum;
+    }
+}
+
+// Постоянный пул: потоки создаются один раз и ждут работу на барьере.
+// run(f) выполняет f(threadid) на всех nthreads потоках (вызывающий поток —
+// threadid 0) и возвращается, когда все закончили; sync() внутри f — барьер
+// между фазами одной задачи.
+class thread_pool {
+    int nthreads;
+    void (*call)(void *, int) = nullptr;
+    void *task = nullptr;
+    bool stop = false;
+    barrier<> start, done, phase;
+    vector<jthread> workers;
+
+public:
+    explicit thread_pool(int nthreads) : nthreads(nthreads), start(nthreads), done(nthreads), phase(nthreads) {
+        for (int threadid = 1; threadid < nthreads; threadid++)
+            workers.emplace_back([this, threadid] {
+                while (true) {
+                    start.arrive_and_wait();
+                    if (stop)
+                        return;
+                    call(task, threadid);
+                    done.arrive_and_wait();
+                }
+            });
+    }
+
+    ~thread_pool() {
+        stop = true;
+        start.arrive_and_wait();
+    }
+
+    int size() const { return nthreads; }
+
+    template <class F>
+    void run(F &&f) {
+        call = [](void *p, int threadid) { (*(remove_reference_t<F>*)p)(threadid); };
+        task = (void*)&f;
+        start.arrive_and_wait();
+        f(0);
+        done.arrive_and_wait();
+    }
+
+    // f(lb, ub) на равных частях [0, count), части отличаются не больше чем на 1
+    template <class F>
+    void parallel_for(int count, F &&f) {
+        run([&](int threadid) {
+            f((int)((long long)count * threadid / nthreads), (int)((long long)count * (threadid + 1) / nthreads));
+        });
+    }
+
+    void sync() { phase.arrive_and_wait(); }
+};
+
+// статистика планировщика по потокам: время в задачах, время поиска работы,
+// число выполненных кусков и сколько из них украдено
+struct steal_stats {
+    vector<double> busy, idle;
+    vector<int> chunks, stolen;
+};
+
+// Планировщик с кражей работы поверх thread_pool: [0, count) режется на куски
+// по grain элементов, каждый поток получает очередь из подряд идущих кусков и
+// берёт их с начала, а опустошив свою — крадёт с конца чужих очередей. Новых
+// кусков во время работы не появляется, поэтому поток заканчивает, когда пусты
+// все очереди.
+class work_stealing_scheduler {
+    struct alignas(64) range_queue {
+        mutex mut;
+        deque<pair<int, int>> ranges;
+    };
+    thread_pool &pool;
+    vector<range_queue> queues;
+
+    bool pop_front(int threadid, pair<int, int> &r) {
+        lock_guard<mutex> lock(queues[threadid].mut);
+        if (queues[threadid].ranges.empty())
+            return false;
+        r = queues[threadid].ranges.front();
+        queues[threadid].ranges.pop_front();
+        return true;
+    }
+
+    bool steal(int threadid, pair<int, int> &r) {
+        for (int k = 1; k < pool.size(); k++) {
+            range_queue &victim = queues[(threadid + k) % pool.size()];
+            lock_guard<mutex> lock(victim.mut);
+            if (!victim.ranges.empty()) {
+                r = victim.ranges.back();
+                victim.ranges.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    steal_stats stats;
+
+    explicit work_stealing_scheduler(thread_pool &pool) : pool(pool), queues(pool.size()) {
+        stats.busy.assign(pool.size(), 0.0);
+        stats.idle.assign(pool.size(), 0.0);
+        stats.chunks.assign(pool.size(), 0);
+        stats.stolen.assign(pool.size(), 0);
+    }
+
+    void reset_stats() {
+        fill(stats.busy.begin(), stats.busy.end(), 0.0);
+        fill(stats.idle.begin(), stats.idle.end(), 0.0);
+        fill(stats.chunks.begin(), stats.chunks.end(), 0);
+        fill(stats.stolen.begin(), stats.stolen.end(), 0);
+    }
+
+    // f(lb, ub) для всех кусков [0, count); возвращается, когда выполнены все
+    template <class F>
+    void parallel_for(int count, int grain, F &&f) {
+        const int nthreads = pool.size();
+        grain = max(grain, 1);
+        const int nchunks = (count + grain - 1) / grain;
+        for (int t = 0; t < nthreads; t++) {
+            int cb = (int)((long long)nchunks * t / nthreads), ce = (int)((long long)nchunks * (t + 1) / nthreads);
+            for (int ch = cb; ch < ce; ch++)
+                queues[t].ranges.emplace_back(ch * grain, min(count, (ch + 1) * grain));
+        }
+        pool.run([&](int threadid) {
+            const auto start{chrono::steady_clock::now()};
+            double busy = 0.0;
+            pair<int, int> r;
+            while (true) {
+                bool own = pop_front(threadid, r);
+                if (!own && !steal(threadid, r))
+                    break;
+                const auto t0{chrono::steady_clock::now()};
+                f(r.first, r.second);
+                busy += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+                stats.chunks[threadid]++;
+                stats.stolen[threadid] += !own;
+            }
+            const chrono::duration<double> total{chrono::steady_clock::now() - start};
+            stats.busy[threadid] += busy;
+            stats.idle[threadid] += total.count() - busy;
+        });
+    }
+};
+
+void matrix_vector_product_csr(const csr_matrix *A, double *b, double *c, const int *bounds, int threadid)
+{
+    csr_spmv_rows(A, b, c, bounds[threadid], bounds[threadid + 1]);
+}
+
+void matrix_vector_product_sell(const sell_matrix *A, double *b, double *c, const int *bounds, int threadid)
+{
+    sell_spmv_chunks(A, b, c, bounds[threadid], bounds[threadid + 1]);
+}
+
+// тестовая разреженная матрица: плотность падает от 2*density в первой строке до 0 в последней
+bool sparse_entry(int i, int j, int m, double density)
+{
+    if (i == j)
+        return true;
+    uint32_t h = (uint32_t)i * 2654435761u ^ (uint32_t)j * 2246822519u;
+    h ^= h >> 15;
+    h *= 2654435761u;
+    h ^= h >> 13;
+    return h < density * 2.0 * (1.0 - (double)i / m) * 4294967295.0;
+}
+
 void run_serial(size_t n, size_t m)
 {
     double *a, *b, *c;
@@ -87,8 +275,52 @@ void run_serial(size_t n, size_t m)
 }
 
 void run_parallel(size_t n, size_t m, int nthreads) {
+    double *a, *b, *c;
+    thread_pool pool(nthreads);
+
+    a = (double*)kernel_alloc(sizeof(*a) * m * n);
+    b = (double*)kernel_alloc(sizeof(*b) * n);
+    c = (double*)kernel_alloc(sizeof(*c) * m);
+
+    if (a == NULL || b == NULL || c == NULL)
+        {
+            kernel_free(a);
+            kernel_free(b);
+            kernel_free(c);
+            printf("Error allocate memory!\n");
+            exit(1);
+        }
+    vector<int> tlb(nthreads, -1);
+    if (kernel_alloc_stats())
+        pool.run([&](int threadid) { tlb[threadid] = tlb_open(); });
+    // потоки пула уже созданы, в замер попадают только init и умножение;
+    // b делится между потоками иначе, чем строки, поэтому между фазами барьер
+    const auto start{chrono::steady_clock::now()};
+    pool.run([&](int threadid) {
+        init(a, b, c, m, n, nthreads, threadid);
+        pool.sync();
+        matrix_vector_product_parallel(a, b, c, m, n, nthreads, threadid);
+    });
+    const auto end{chrono::steady_clock::now()};
+    const chrono::duration<double> elapsed_seconds{end - start};
+
+    cout << "Elapsed time (parallel): " << elapsed_seconds.count() << " sec." << endl;
+    cout << "Speed: " << par/elapsed_seconds.count() << endl;
+    if (kernel_alloc_stats()) {
+        // init и умножение делят строки одинаково — первое касание на том же потоке
+        huge_report("a", a, sizeof(*a) * m * n);
+        cout << "dTLB load misses: " << tlb_close(tlb.data(), nthreads) << endl;
+    }
+    kernel_free(a);
+    kernel_free(b);
+    kernel_free(c);
+}
+
+void run_parallel_sparse(size_t n, size_t m, int nthreads, double density) {
     double *a, *b, *c;
     vector<jthread> threads;
+    csr_matrix A;
+    sell_matrix S;
 
     a = (double*)malloc(sizeof(*a) * m * n);
     b = (double*)malloc(sizeof(*b) * n);
@@ -102,26 +334,312 @@ void run_parallel(size_t n, size_t m, int nthreads) {
             printf("Error allocate memory!\n");
             exit(1);
         }
-    const auto start{chrono::steady_clock::now()};
+    for (int i = 0; i < (int)m; i++)
+        for (int j = 0; j < (int)n; j++)
+            a[i * n + j] = sparse_entry(i, j, m, density) ? i + j + 1 : 0.0;
+    for (int j = 0; j < (int)n; j++)
+        b[j] = j;
+    if (csr_from_dense(a, m, n, &A) != 0 || sell_from_csr(&A, 8, 256, &S) != 0)
+        {
+            free(a);
+            free(b);
+            free(c);
+            printf("Error allocate memory!\n");
+            exit(1);
+        }
+
+    const auto start_dense{chrono::steady_clock::now()};
     for(int threadid = 0; threadid < nthreads; threadid++){
-        threads.emplace_back(init, a, b, c, m, n, nthreads, threadid);
+        threads.emplace_back(matrix_vector_product_parallel, a, b, c, m, n, nthreads, threadid);
     }
     threads.clear();
+    const chrono::duration<double> dense{chrono::steady_clock::now() - start_dense};
 
+    vector<int> bounds(nthreads + 1);
+    const auto start_csr{chrono::steady_clock::now()};
+    csr_partition(&A, nthreads, bounds.data());
     for(int threadid = 0; threadid < nthreads; threadid++){
-        threads.emplace_back(matrix_vector_product_parallel, a, b, c, m, n, nthreads, threadid);
+        threads.emplace_back(matrix_vector_product_csr, &A, b, c, bounds.data(), threadid);
     }
     threads.clear();
-    const auto end{chrono::steady_clock::now()};
-    const chrono::duration<double> elapsed_seconds{end - start};
+    const chrono::duration<double> csr{chrono::steady_clock::now() - start_csr};
 
-    cout << "Elapsed time (parallel): " << elapsed_seconds.count() << " sec." << endl;
-    cout << "Speed: " << par/elapsed_seconds.count() << endl;
+    const auto start_sell{chrono::steady_clock::now()};
+    sell_partition(&S, nthreads, bounds.data());
+    for(int threadid = 0; threadid < nthreads; threadid++){
+        threads.emplace_back(matrix_vector_product_sell, &S, b, c, bounds.data(), threadid);
+    }
+    threads.clear();
+    const chrono::duration<double> sell{chrono::steady_clock::now() - start_sell};
+
+    cout << "nnz: " << A.nnz << endl;
+    cout << "Elapsed time (parallel dense): " << dense.count() << " sec." << endl;
+    cout << "Elapsed time (parallel csr): " << csr.count() << " sec." << endl;
+    cout << "Elapsed time (parallel sell): " << sell.count() << " sec." << endl;
+    cout << "Speed csr: " << dense.count() / csr.count() << ", sell: " << dense.count() / sell.count() << endl;
+    csr_free(&A);
+    sell_free(&S);
     free(a);
     free(b);
     free(c);
 }
 
+struct matvec_args {
+    double *a, *b, *c;
+    int m, n, nthreads;
+};
+
+void bench_parallel(void *p) {
+    auto *x = (matvec_args*)p;
+    vector<jthread> threads;
+    for(int threadid = 0; threadid < x->nthreads; threadid++){
+        threads.emplace_back(matrix_vector_product_parallel, x->a, x->b, x->c, x->m, x->n, x->nthreads, threadid);
+    }
+}
+
+struct pool_args {
+    thread_pool *pool;
+    double *a, *b, *c;
+    int m, n;
+};
+
+void bench_pool(void *p) {
+    auto *x = (pool_args*)p;
+    x->pool->parallel_for(x->m, [x](int lb, int ub) {
+        matrix_vector_product_rows(x->a, x->b, x->c, x->n, lb, ub);
+    });
+}
+
+// в отличие от run_parallel выделение памяти и init не попадают в замер;
+// peak — пик STREAM, с которым сравнивается пропускная способность ядра
+void run_bench(size_t n, size_t m, int nthreads, double peak) {
+    double *a, *b, *c;
+    vector<jthread> threads;
+
+    a = (double*)kernel_alloc(sizeof(*a) * m * n);
+    b = (double*)kernel_alloc(sizeof(*b) * n);
+    c = (double*)kernel_alloc(sizeof(*c) * m);
+
+    if (a == NULL || b == NULL || c == NULL)
+        {
+            kernel_free(a);
+            kernel_free(b);
+            kernel_free(c);
+            printf("Error allocate memory!\n");
+            exit(1);
+        }
+    for(int threadid = 0; threadid < nthreads; threadid++){
+        threads.emplace_back(init, a, b, c, m, n, nthreads, threadid);
+    }
+    threads.clear();
+
+    matvec_args args{a, b, c, (int)m, (int)n, nthreads};
+    double bytes = sizeof(double) * ((double)m * n + n + m);
+    double flops = 2.0 * m * n;
+    bench_report("parallel", m, n, nthreads, bench_run(bench_parallel, &args, 2, 10),
+                 bytes, flops, peak, 0.0);
+    thread_pool pool(nthreads);
+    pool_args pargs{&pool, a, b, c, (int)m, (int)n};
+    bench_report("pool", m, n, nthreads, bench_run(bench_pool, &pargs, 2, 10),
+                 bytes, flops, peak, 0.0);
+    kernel_free(a);
+    kernel_free(b);
+    kernel_free(c);
+}
+
+void init_rows(double *a, double *c, int n, int lb, int ub) {
+    for (int i = lb; i < ub; i++) {
+        for (int j = 0; j < n; j++)
+            a[(size_t)i * n + j] = i + j;
+        c[i] = 0.0;
+    }
+}
+
+// статическое разбиение (остаток строк у последнего потока) против кражи работы
+// кусками по grain строк; для обоих печатается занятость потоков
+void run_steal(size_t n, size_t m, int nthreads, int grain) {
+    double *a, *b, *c;
+    thread_pool pool(nthreads);
+    work_stealing_scheduler sched(pool);
+    vector<double> busy(nthreads);
+
+    a = (double*)malloc(sizeof(*a) * m * n);
+    b = (double*)malloc(sizeof(*b) * n);
+    c = (double*)malloc(sizeof(*c) * m);
+
+    if (a == NULL || b == NULL || c == NULL)
+        {
+            free(a);
+            free(b);
+            free(c);
+            printf("Error allocate memory!\n");
+            exit(1);
+        }
+
+    // первое касание страниц не в замере, иначе его оплачивает только первый вариант
+    pool.run([&](int threadid) {
+        init(a, b, c, m, n, nthreads, threadid);
+    });
+
+    const auto start_static{chrono::steady_clock::now()};
+    pool.run([&](int threadid) {
+        const auto t0{chrono::steady_clock::now()};
+        init(a, b, c, m, n, nthreads, threadid);
+        busy[threadid] = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        pool.sync();
+        const auto t1{chrono::steady_clock::now()};
+        matrix_vector_product_parallel(a, b, c, m, n, nthreads, threadid);
+        busy[threadid] += chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+    });
+    const chrono::duration<double> static_time{chrono::steady_clock::now() - start_static};
+
+    const auto start_steal{chrono::steady_clock::now()};
+    pool.parallel_for(n, [&](int lb, int ub) {
+        for (int j = lb; j < ub; j++)
+            b[j] = j;
+    });
+    sched.parallel_for(m, grain, [&](int lb, int ub) {
+        init_rows(a, c, n, lb, ub);
+    });
+    sched.parallel_for(m, grain, [&](int lb, int ub) {
+        matrix_vector_product_rows(a, b, c, n, lb, ub);
+    });
+    const chrono::duration<double> steal_time{chrono::steady_clock::now() - start_steal};
+
+    cout << "Elapsed time (static): " << static_time.count() << " sec, (stealing, grain " << grain << "): "
+         << steal_time.count() << " sec." << endl;
+    for (int t = 0; t < nthreads; t++)
+        cout << "  thread " << t << ": static busy " << busy[t] * 1e3 << " ms, idle "
+             << (static_time.count() - busy[t]) * 1e3 << " ms | stealing busy " << sched.stats.busy[t] * 1e3
+             << " ms, idle " << sched.stats.idle[t] * 1e3 << " ms, chunks " << sched.stats.chunks[t]
+             << " (stolen " << sched.stats.stolen[t] << ")" << endl;
+    free(a);
+    free(b);
+    free(c);
+}
+
+// Потоки пула по очереди берут панели строк из отображённого файла; взявший
+// панель p запрашивает упреждающее чтение панели p + depth, поэтому чтение
+// следующих панелей идёт параллельно с умножением, а готовая панель отпускается.
+void matrix_vector_product_ooc(thread_pool &pool, const matfile *f, const double *b, double *c,
+                               int64_t panel_rows, int depth)
+{
+    const int64_t npanels = (f->m + panel_rows - 1) / panel_rows;
+    auto panel_ub = [&](int64_t p) { return min(f->m, (p + 1) * panel_rows); };
+    atomic<int64_t> next{0};
+    for (int64_t p = 0; p < depth && p < npanels; p++)
+        matfile_prefetch(f, p * panel_rows, panel_ub(p));
+    pool.run([&](int) {
+        for (int64_t p = next++; p < npanels; p = next++) {
+            if (p + depth < npanels)
+                matfile_prefetch(f, (p + depth) * panel_rows, panel_ub(p + depth));
+            matrix_vector_product_rows(f->a, b, c, f->n, p * panel_rows, panel_ub(p));
+            matfile_release(f, p * panel_rows, panel_ub(p));
+        }
+    });
+}
+
+void init_panel(double *rows, int64_t lb, int64_t ub, int64_t n, void *) {
+    for (int64_t i = lb; i < ub; i++)
+        for (int64_t j = 0; j < n; j++)
+            rows[(i - lb) * n + j] = i + j;
+}
+
+// матрица из init (a[i][j] = i + j) в файл для режима ooc
+void write_matrix_file(size_t n, size_t m, const string &path) {
+    const auto start{chrono::steady_clock::now()};
+    if (matfile_write(path.c_str(), m, n, (64 << 20) / (sizeof(double) * n) + 1, init_panel, nullptr) != 0) {
+        cout << "Error writing " << path << "!" << endl;
+        exit(1);
+    }
+    const chrono::duration<double> elapsed_seconds{chrono::steady_clock::now() - start};
+    cout << "Wrote " << m << " x " << n << " matrix to " << path << ": " << elapsed_seconds.count() << " sec." << endl;
+}
+
+void run_parallel_ooc(const string &path, int nthreads, size_t panel_mb, int depth) {
+    matfile f;
+    double *b, *c;
+    thread_pool pool(nthreads);
+
+    if (matfile_open(path.c_str(), &f) != 0) {
+        cout << "Error opening " << path << "!" << endl;
+        exit(1);
+    }
+    b = (double*)malloc(sizeof(*b) * f.n);
+    c = (double*)malloc(sizeof(*c) * f.m);
+    if (b == NULL || c == NULL)
+        {
+            free(b);
+            free(c);
+            matfile_close(&f);
+            printf("Error allocate memory!\n");
+            exit(1);
+        }
+    for (int64_t j = 0; j < f.n; j++)
+        b[j] = j;
+
+    const int64_t panel_rows = matfile_panel_rows(&f, panel_mb << 20);
+    const auto start{chrono::steady_clock::now()};
+    matrix_vector_product_ooc(pool, &f, b, c, panel_rows, depth);
+    const chrono::duration<double> elapsed_seconds{chrono::steady_clock::now() - start};
+
+    // c[i] = i * sum(j) + sum(j^2)
+    double nn = f.n, s1 = nn * (nn - 1) / 2, s2 = (nn - 1) * nn * (2 * nn - 1) / 6, err = 0.0;
+    for (int64_t i = 0; i < f.m; i++) {
+        // при n = 1 эталон строки 0 равен нулю: там ошибка абсолютная
+        double ref = i * s1 + s2;
+        err = max(err, fabs(c[i] - ref) / (ref != 0.0 ? fabs(ref) : 1.0));
+    }
+    cout << "Elapsed time (out-of-core, " << f.m << " x " << f.n << ", panels of " << panel_rows << " rows): "
+         << elapsed_seconds.count() << " sec, " << sizeof(double) * (double)f.m * f.n / elapsed_seconds.count() / 1048576.0
+         << " MB/s, max relative error " << err << endl;
+    free(b);
+    free(c);
+    matfile_close(&f);
+}
+
+struct forkjoin_args {
+    thread_pool *pool;
+    int nthreads, reps;
+};
+
+void empty_task(int) {}
+
+void forkjoin_jthread(void *p) {
+    auto *x = (forkjoin_args*)p;
+    for (int r = 0; r < x->reps; r++) {
+        vector<jthread> threads;
+        for(int threadid = 0; threadid < x->nthreads; threadid++)
+            threads.emplace_back(empty_task, threadid);
+    }
+}
+
+void forkjoin_pool(void *p) {
+    auto *x = (forkjoin_args*)p;
+    for (int r = 0; r < x->reps; r++)
+        x->pool->run(empty_task);
+}
+
+void forkjoin_sync(void *p) {
+    auto *x = (forkjoin_args*)p;
+    x->pool->run([x](int) {
+        for (int r = 0; r < x->reps; r++)
+            x->pool->sync();
+    });
+}
+
+// стоимость одного fork/join пустой задачи: одноразовые jthread против пула,
+// и отдельно стоимость барьера между фазами внутри задачи пула
+void run_forkjoin(int nthreads, int reps) {
+    thread_pool pool(nthreads);
+    forkjoin_args args{&pool, nthreads, reps};
+    bench_stats jt = bench_run(forkjoin_jthread, &args, 1, 5);
+    bench_stats pl = bench_run(forkjoin_pool, &args, 1, 5);
+    bench_stats sy = bench_run(forkjoin_sync, &args, 1, 5);
+    cout << nthreads << " threads: jthread " << jt.median / reps * 1e6 << " us, pool "
+         << pl.median / reps * 1e6 << " us, pool sync " << sy.median / reps * 1e6 << " us" << endl;
+}
+
 int main(int argc, char *argv[])
 {
     size_t M = 20000;
@@ -130,7 +648,53 @@ int main(int argc, char *argv[])
         M = atoi(argv[1]);
     if (argc > 2)
         N = atoi(argv[2]);
+    string mode = (argc > 3) ? argv[3] : "dense";
     int threads_count[8] = {1, 2, 4, 7, 8, 16, 20, 40};
+    if (mode == "bench") {
+        // пик STREAM всей машины (OpenMP по всем аппаратным потокам) меряется один
+        // раз: проценты показывают, какую долю пика машины берёт ядро с данным
+        // числом потоков, и не превышают 100%
+        const double peak = bench_stream_peak(1 << 25);
+        for(int i = 0; i < 8; i++)
+            run_bench(M, N, threads_count[i], peak);
+        return 0;
+    }
+    if (mode == "forkjoin") {
+        int reps = (argc > 4) ? atoi(argv[4]) : 1000;
+        for(int i = 0; i < 8; i++)
+            run_forkjoin(threads_count[i], reps);
+        return 0;
+    }
+    if (mode == "write") {
+        write_matrix_file(M, N, (argc > 4) ? argv[4] : "matrix.bin");
+        return 0;
+    }
+    if (mode == "ooc") {
+        string path = (argc > 4) ? argv[4] : "matrix.bin";
+        size_t panel_mb = (argc > 5) ? atoi(argv[5]) : 16;
+        int depth = (argc > 6) ? atoi(argv[6]) : 4;
+        for(int i = 0; i < 8; i++){
+            cout << threads_count[i] << endl;
+            run_parallel_ooc(path, threads_count[i], panel_mb, depth);
+        }
+        return 0;
+    }
+    if (mode == "steal") {
+        int grain = (argc > 4) ? atoi(argv[4]) : 64;
+        for(int i = 0; i < 8; i++){
+            cout << threads_count[i] << endl;
+            run_steal(M, N, threads_count[i], grain);
+        }
+        return 0;
+    }
+    if (mode == "csr") {
+        double density = (argc > 4) ? atof(argv[4]) : 0.01;
+        for(int i = 0; i < 8; i++){
+            cout << threads_count[i] << endl;
+            run_parallel_sparse(M, N, threads_count[i], density);
+        }
+        return 0;
+    }
     for(int i = 0; i < 8; i++){
         cout << threads_count[i] << endl;
         run_serial(M, N);